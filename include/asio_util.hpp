@@ -8,6 +8,9 @@
 #include <folly/experimental/coro/Task.h>
 
 #include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+#include <happy_eyeballs.h>
 
 class Executor : public folly::Executor {
 public:
@@ -21,9 +24,10 @@ public:
 
 	boost::asio::io_context& m_io_context;
 };
+template <typename Acceptor, typename Socket>
 class AcceptorAwaiter {
 public:
-	AcceptorAwaiter(boost::asio::ip::tcp::acceptor& acceptor, boost::asio::ip::tcp::socket& socket)
+	AcceptorAwaiter(Acceptor& acceptor, Socket& socket)
 		: m_acceptor(acceptor)
 		, m_socket(socket) {
 	}
@@ -38,13 +42,13 @@ public:
 	auto await_resume() noexcept { return m_ec; }
 
 private:
-	boost::asio::ip::tcp::acceptor& m_acceptor;
-	boost::asio::ip::tcp::socket& m_socket;
+	Acceptor& m_acceptor;
+	Socket& m_socket;
 	boost::system::error_code m_ec{};
 };
 
-inline folly::coro::Task<boost::system::error_code> async_accept(
-	boost::asio::ip::tcp::acceptor& acceptor, boost::asio::ip::tcp::socket& socket) noexcept {
+template <typename Acceptor, typename Socket>
+inline folly::coro::Task<boost::system::error_code> async_accept(Acceptor& acceptor, Socket& socket) noexcept {
 	co_return co_await AcceptorAwaiter{acceptor, socket};
 }
 
@@ -178,35 +182,125 @@ inline folly::coro::Task<std::pair<boost::system::error_code, size_t>> async_wri
 class ConnectAwaiter {
 public:
 	ConnectAwaiter(boost::asio::io_context& io_context, boost::asio::ip::tcp::socket& socket,
-		const std::string& host, const std::string& port)
-		: io_context_(io_context)
+		const std::string& host, const std::string& port, HappyEyeballsOptions options)
+		: m_resolver(io_context)
 		, m_socket(socket)
 		, host_(host)
-		, port_(port) {
+		, port_(port)
+		, m_options(options) {
 	}
 
 	bool await_ready() const noexcept { return false; }
 	void await_suspend(std::coroutine_handle<> handle) {
-		boost::asio::ip::tcp::resolver resolver(io_context_);
-		auto endpoints = resolver.resolve(host_, port_);
-		boost::asio::async_connect(m_socket, endpoints, [this, handle](boost::system::error_code ec, boost::asio::ip::tcp::endpoint) mutable {
-			m_ec = ec;
-			handle.resume();
+		m_resolver.async_resolve(host_, port_, [this, handle](boost::system::error_code ec, boost::asio::ip::tcp::resolver::results_type results) mutable {
+			if (ec) {
+				m_ec = ec;
+				handle.resume();
+				return;
+			}
+			async_connect_happy_eyeballs(m_socket, results, m_options, [this, handle](boost::system::error_code ec, boost::asio::ip::tcp::endpoint) mutable {
+				m_ec = ec;
+				handle.resume();
+			});
 		});
 	}
 	auto await_resume() noexcept { return m_ec; }
 
 private:
-	boost::asio::io_context& io_context_;
+	boost::asio::ip::tcp::resolver m_resolver;
 	boost::asio::ip::tcp::socket& m_socket;
 	std::string host_;
 	std::string port_;
+	HappyEyeballsOptions m_options;
 	boost::system::error_code m_ec{};
 };
 
+// resolves host and races the endpoints, see HappyEyeballsConnect
 inline folly::coro::Task<boost::system::error_code> async_connect(boost::asio::io_context& io_context, boost::asio::ip::tcp::socket& socket,
-	const std::string& host, const std::string& port) noexcept {
-	co_return co_await ConnectAwaiter{io_context, socket, host, port};
+	const std::string& host, const std::string& port, HappyEyeballsOptions options = {}) noexcept {
+	co_return co_await ConnectAwaiter{io_context, socket, host, port, options};
+}
+
+template <typename Socket>
+class WaitAwaiter {
+public:
+	WaitAwaiter(Socket& socket, boost::asio::socket_base::wait_type wait_type)
+		: m_socket(socket)
+		, m_wait_type(wait_type) {
+	}
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) {
+		m_socket.async_wait(m_wait_type, [this, handle](const boost::system::error_code& ec) {
+			m_ec = ec;
+			handle.resume();
+		});
+	}
+	auto await_resume() noexcept { return m_ec; }
+
+private:
+	Socket& m_socket;
+	boost::asio::socket_base::wait_type m_wait_type;
+	boost::system::error_code m_ec{};
+};
+
+template <typename Socket>
+inline folly::coro::Task<boost::system::error_code> async_wait(Socket& socket, boost::asio::socket_base::wait_type wait_type) noexcept {
+	co_return co_await WaitAwaiter{socket, wait_type};
+}
+
+template <typename Stream>
+class HandshakeAwaiter {
+public:
+	HandshakeAwaiter(Stream& stream, boost::asio::ssl::stream_base::handshake_type type)
+		: m_stream(stream)
+		, m_type(type) {
+	}
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) {
+		m_stream.async_handshake(m_type, [this, handle](const boost::system::error_code& ec) {
+			m_ec = ec;
+			handle.resume();
+		});
+	}
+	auto await_resume() noexcept { return m_ec; }
+
+private:
+	Stream& m_stream;
+	boost::asio::ssl::stream_base::handshake_type m_type;
+	boost::system::error_code m_ec{};
+};
+
+template <typename Stream>
+inline folly::coro::Task<boost::system::error_code> async_handshake(Stream& stream, boost::asio::ssl::stream_base::handshake_type type) noexcept {
+	co_return co_await HandshakeAwaiter{stream, type};
+}
+
+template <typename Stream>
+class SslShutdownAwaiter {
+public:
+	SslShutdownAwaiter(Stream& stream)
+		: m_stream(stream) {
+	}
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) {
+		m_stream.async_shutdown([this, handle](const boost::system::error_code& ec) {
+			m_ec = ec;
+			handle.resume();
+		});
+	}
+	auto await_resume() noexcept { return m_ec; }
+
+private:
+	Stream& m_stream;
+	boost::system::error_code m_ec{};
+};
+
+template <typename Stream>
+inline folly::coro::Task<boost::system::error_code> async_shutdown(Stream& stream) noexcept {
+	co_return co_await SslShutdownAwaiter{stream};
 }
 
 class TimerAwaiter {
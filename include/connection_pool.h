@@ -0,0 +1,180 @@
+#pragma once
+
+#include <sys/socket.h>
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <asio_util.hpp>
+
+struct ConnectionPoolConfig {
+	// idle connections kept open per endpoint even when they pass idle_timeout, refilled by the maintenance timer
+	std::size_t min_idle{0};
+	// idle connections above this are closed on release instead of being kept
+	std::size_t max_idle{8};
+	std::chrono::milliseconds idle_timeout{std::chrono::seconds(60)};
+	// how often idle connections are health checked and evicted
+	std::chrono::milliseconds maintenance_interval{std::chrono::seconds(5)};
+	bool tcp_nodelay{true};
+};
+
+struct PooledConnection {
+	PooledConnection(boost::asio::io_context& io_context, std::string key)
+		: socket(io_context)
+		, key(std::move(key)) {
+	}
+
+	boost::asio::ip::tcp::socket socket;
+	std::string key;
+	std::chrono::steady_clock::time_point last_used{std::chrono::steady_clock::now()};
+};
+
+// Keep-alive pool of client connections keyed by host:port, so a request to a backend costs a write and a read
+// instead of a handshake. A pool belongs to one io_context and, like the sockets it holds, must only be used from
+// that io_context's thread; use one pool per IoContextPool context.
+class ConnectionPool final {
+public:
+	ConnectionPool(boost::asio::io_context& io_context, ConnectionPoolConfig config = {})
+		: m_io_context(io_context)
+		, m_config(config)
+		, m_maintenance_timer(io_context) {
+		scheduleMaintenance();
+	}
+	~ConnectionPool() { m_maintenance_timer.cancel(); }
+
+	ConnectionPool(const ConnectionPool&) = delete;
+	ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+	// most recently released healthy connection first, its congestion window is the warmest; connects otherwise
+	folly::coro::Task<std::pair<boost::system::error_code, std::unique_ptr<PooledConnection>>> acquire(const std::string& host, const std::string& port) {
+		auto key = host + ":" + port;
+		auto& endpoint = m_endpoints.try_emplace(key, host, port).first->second;
+		while (!endpoint.idle.empty()) {
+			auto connection = std::move(endpoint.idle.back());
+			endpoint.idle.pop_back();
+			if (healthy(*connection)) {
+				m_reused++;
+				co_return std::make_pair(boost::system::error_code{}, std::move(connection));
+			}
+			close(*connection);
+		}
+		auto connection = std::make_unique<PooledConnection>(m_io_context, std::move(key));
+		auto ec = co_await connect(host, port, *connection);
+		if (ec)
+			co_return std::make_pair(ec, nullptr);
+		co_return std::make_pair(ec, std::move(connection));
+	}
+
+	// reusable must be false when the connection is in an unknown protocol state (error, partial read, timeout)
+	void release(std::unique_ptr<PooledConnection> connection, bool reusable = true) {
+		if (!connection)
+			return;
+		auto it = m_endpoints.find(connection->key);
+		if (!reusable || it == m_endpoints.end() || it->second.idle.size() >= m_config.max_idle || !connection->socket.is_open()) {
+			close(*connection);
+			return;
+		}
+		connection->last_used = std::chrono::steady_clock::now();
+		it->second.idle.emplace_back(std::move(connection));
+	}
+
+	std::size_t idleCount(const std::string& host, const std::string& port) const {
+		auto it = m_endpoints.find(host + ":" + port);
+		return it == m_endpoints.end() ? 0 : it->second.idle.size();
+	}
+	uint64_t connectCount() const { return m_connected; }
+	uint64_t reuseCount() const { return m_reused; }
+
+private:
+	struct Endpoint {
+		Endpoint(std::string host, std::string port)
+			: host(std::move(host))
+			, port(std::move(port)) {
+		}
+
+		std::string host;
+		std::string port;
+		// oldest at the front
+		std::deque<std::unique_ptr<PooledConnection>> idle;
+		bool refilling{false};
+	};
+
+	folly::coro::Task<boost::system::error_code> connect(const std::string& host, const std::string& port, PooledConnection& connection) {
+		auto ec = co_await async_connect(m_io_context, connection.socket, host, port);
+		if (ec)
+			co_return ec;
+		m_connected++;
+		boost::system::error_code ignore_ec;
+		connection.socket.set_option(boost::asio::ip::tcp::no_delay(m_config.tcp_nodelay), ignore_ec);
+		connection.socket.set_option(boost::asio::socket_base::keep_alive(true), ignore_ec);
+		co_return ec;
+	}
+
+	// an idle connection must have nothing to read: EOF means the peer closed it, data means a stale reply
+	static bool healthy(PooledConnection& connection) {
+		if (!connection.socket.is_open())
+			return false;
+		char c;
+		auto ret = ::recv(connection.socket.native_handle(), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+		return ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+	}
+
+	static void close(PooledConnection& connection) {
+		boost::system::error_code ignore_ec;
+		connection.socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignore_ec);
+		connection.socket.close(ignore_ec);
+	}
+
+	void scheduleMaintenance() {
+		m_maintenance_timer.expires_after(m_config.maintenance_interval);
+		m_maintenance_timer.async_wait([this](const boost::system::error_code& ec) {
+			if (ec)
+				return;
+			maintain();
+			scheduleMaintenance();
+		});
+	}
+
+	void maintain() {
+		auto now = std::chrono::steady_clock::now();
+		for (auto& [key, endpoint] : m_endpoints) {
+			auto& idle = endpoint.idle;
+			std::erase_if(idle, [](auto& connection) {
+				if (healthy(*connection))
+					return false;
+				close(*connection);
+				return true;
+			});
+			while (idle.size() > m_config.min_idle && now - idle.front()->last_used > m_config.idle_timeout) {
+				close(*idle.front());
+				idle.pop_front();
+			}
+			if (idle.size() < m_config.min_idle && !endpoint.refilling)
+				refill(endpoint).scheduleOn(&m_executor).start();
+		}
+	}
+
+	folly::coro::Task<void> refill(Endpoint& endpoint) {
+		endpoint.refilling = true;
+		while (endpoint.idle.size() < m_config.min_idle) {
+			auto connection = std::make_unique<PooledConnection>(m_io_context, endpoint.host + ":" + endpoint.port);
+			if (co_await connect(endpoint.host, endpoint.port, *connection))
+				break;
+			endpoint.idle.emplace_front(std::move(connection));
+		}
+		endpoint.refilling = false;
+		co_return;
+	}
+
+	boost::asio::io_context& m_io_context;
+	Executor m_executor{m_io_context};
+	ConnectionPoolConfig m_config;
+	boost::asio::steady_timer m_maintenance_timer;
+	// node based, refill keeps a reference across suspension
+	std::unordered_map<std::string, Endpoint> m_endpoints;
+	uint64_t m_connected{0};
+	uint64_t m_reused{0};
+};
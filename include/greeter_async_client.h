@@ -1,89 +1,442 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <grpc/support/log.h>
 #include <grpcpp/grpcpp.h>
 
 
+#include "grpc_compression.h"
+#include "grpc_tag.h"
 #include "helloworld.grpc.pb.h"
 
 using grpc::Channel;
+using grpc::ClientAsyncReader;
+using grpc::ClientAsyncReaderWriter;
 using grpc::ClientAsyncResponseReader;
 using grpc::ClientContext;
 using grpc::CompletionQueue;
 using grpc::Status;
 using helloworld::Greeter;
+using helloworld::HelloBatchReply;
+using helloworld::HelloBatchRequest;
 using helloworld::HelloReply;
 using helloworld::HelloRequest;
 
+// Channels to target that do not share a connection. gRPC hands channels with
+// equal arguments the same subchannel, so each one gets a distinct index and
+// a subchannel pool of its own.
+inline std::vector<std::shared_ptr<Channel>> CreateChannelPool(
+    const std::string& target, int size,
+    const std::shared_ptr<grpc::ChannelCredentials>& credentials =
+        grpc::InsecureChannelCredentials()) {
+  std::vector<std::shared_ptr<Channel>> channels;
+  for (int i = 0; i < size; ++i) {
+    grpc::ChannelArguments args;
+    args.SetInt("greeter.channel_pool_index", i);
+    args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    channels.emplace_back(grpc::CreateCustomChannel(target, credentials, args));
+  }
+  return channels;
+}
+
+// Calls are multiplexed over a fixed set of completion queues, each drained by
+// its own thread, so any number of RPCs can be in flight from any number of
+// threads without a CompletionQueue or a blocked thread per call.
+//
+// Given several channels, calls are spread over them. One HTTP/2 connection
+// caps the streams in flight and is served by a single I/O thread on either
+// side, several connections lift both limits.
 class GreeterClient {
  public:
-  explicit GreeterClient(std::shared_ptr<Channel> channel)
-      : stub_(Greeter::NewStub(channel)) {}
+  using Callback = std::function<void(const Status&, HelloReply&)>;
+  using BatchCallback = std::function<void(HelloBatchReply&)>;
+  using DoneCallback = std::function<void(const Status&)>;
 
-  // Assembles the client's payload, sends it and presents the response back
-  // from the server.
-  std::string SayHello(const std::string& user) {
-    // Data we are sending to the server.
-    HelloRequest request;
-    request.set_name(user);
+  // How a call picks its channel when there are several.
+  enum class ChannelSelection {
+    // Strict rotation: cheapest, and even as long as calls cost the same.
+    kRoundRobin,
+    // Fewest calls in flight: steers around a connection stalled on flow
+    // control or a slow server, for a scan of the pool per call.
+    kLeastLoaded,
+  };
 
-    // Container for the data we expect from the server.
-    HelloReply reply;
+  // One channel of the pool and the calls in flight on it.
+  class PooledStub {
+   public:
+    explicit PooledStub(const std::shared_ptr<Channel>& channel)
+        : stub_(Greeter::NewStub(channel)) {}
 
-    // Context for the client. It could be used to convey extra information to
-    // the server and/or tweak certain RPC behaviors.
-    ClientContext context;
+    Greeter::Stub* get() { return stub_.get(); }
+    int64_t InFlight() const {
+      return in_flight_.load(std::memory_order_relaxed);
+    }
 
-    // The producer-consumer queue we use to communicate asynchronously with the
-    // gRPC runtime.
-    CompletionQueue cq;
+   private:
+    friend class GreeterClient;
 
-    // Storage for the status of the RPC upon completion.
-    Status status;
+    std::unique_ptr<Greeter::Stub> stub_;
+    std::atomic<int64_t> in_flight_{0};
+  };
+
+  explicit GreeterClient(std::shared_ptr<Channel> channel, int num_cqs = 1)
+      : GreeterClient(std::vector<std::shared_ptr<Channel>>{std::move(channel)},
+                      num_cqs) {}
+
+  GreeterClient(const std::vector<std::shared_ptr<Channel>>& channels,
+                int num_cqs,
+                ChannelSelection selection = ChannelSelection::kRoundRobin)
+      : selection_(selection) {
+    GPR_ASSERT(!channels.empty());
+    for (const auto& channel : channels) {
+      stubs_.emplace_back(std::make_unique<PooledStub>(channel));
+    }
+    for (int i = 0; i < num_cqs; ++i) {
+      cqs_.emplace_back(std::make_unique<CompletionQueue>());
+      threads_.emplace_back([cq = cqs_.back().get()] { AsyncCompleteRpc(cq); });
+    }
+  }
+
+  ~GreeterClient() {
+    // Outstanding calls still complete, Next returns false once they did.
+    for (auto& cq : cqs_) cq->Shutdown();
+    for (auto& thread : threads_) thread.join();
+  }
 
-    // stub_->PrepareAsyncSayHello() creates an RPC object, returning
+  GreeterClient(const GreeterClient&) = delete;
+  GreeterClient& operator=(const GreeterClient&) = delete;
+
+  // Requests and stream messages of at least options.min_bytes go out
+  // compressed. Replies are decompressed whatever the setting. Call before
+  // the first call.
+  void set_compression_options(const CompressionOptions& options) {
+    compression_ = options;
+  }
+
+  // Starts the call and returns, callback runs on a completion queue thread
+  // and must not block it.
+  void AsyncSayHello(const std::string& user, Callback callback) {
+    // Call object to store rpc data
+    auto* call = new AsyncClientCall;
+    call->callback = std::move(callback);
+    call->stub = AcquireStub();
+    // Data we are sending to the server.
+    HelloRequest request;
+    request.set_name(user);
+    if (compression_.Compress(request.ByteSizeLong())) {
+      call->context.set_compression_algorithm(compression_.algorithm);
+    }
+
+    // PrepareAsyncSayHello() creates an RPC object, returning
     // an instance to store in "call" but does not actually start the RPC
     // Because we are using the asynchronous API, we need to hold on to
     // the "call" instance in order to get updates on the ongoing RPC.
-    std::unique_ptr<ClientAsyncResponseReader<HelloReply> > rpc(
-        stub_->PrepareAsyncSayHello(&context, request, &cq));
+    call->response_reader =
+        call->stub->get()->PrepareAsyncSayHello(&call->context, request,
+                                                NextCq());
 
     // StartCall initiates the RPC call
-    rpc->StartCall();
+    call->response_reader->StartCall();
 
     // Request that, upon completion of the RPC, "reply" be updated with the
     // server's response; "status" with the indication of whether the operation
-    // was successful. Tag the request with the integer 1.
-    rpc->Finish(&reply, &status, (void*)1);
-    void* got_tag;
-    bool ok = false;
-    // Block until the next result is available in the completion queue "cq".
-    // The return value of Next should always be checked. This return value
-    // tells us whether there is any kind of event or the cq_ is shutting down.
-    GPR_ASSERT(cq.Next(&got_tag, &ok));
-
-    // Verify that the result from "cq" corresponds, by its tag, our previous
-    // request.
-    GPR_ASSERT(got_tag == (void*)1);
-    // ... and that the request was completed successfully. Note that "ok"
-    // corresponds solely to the request for updates introduced by Finish().
-    GPR_ASSERT(ok);
+    // was successful. Tag the request with the memory address of the call
+    // object, seen by the completion queue thread as a GrpcTag.
+    call->response_reader->Finish(&call->reply, &call->status, call->tag());
+  }
+
+  std::future<std::pair<Status, std::string>> AsyncSayHello(
+      const std::string& user) {
+    auto promise =
+        std::make_shared<std::promise<std::pair<Status, std::string>>>();
+    auto future = promise->get_future();
+    AsyncSayHello(user, [promise](const Status& status, HelloReply& reply) {
+      promise->set_value({status, std::move(*reply.mutable_message())});
+    });
+    return future;
+  }
 
+  // Assembles the client's payload, sends it and presents the response back
+  // from the server.
+  std::string SayHello(const std::string& user) {
+    auto [status, message] = AsyncSayHello(user).get();
     // Act upon the status of the actual RPC.
     if (status.ok()) {
-      return reply.message();
+      return message;
     } else {
       return "RPC failed";
     }
   }
 
+  // Greets all names of request over one server stream. on_batch runs for
+  // every reply batch and done once at the end, both on a completion queue
+  // thread. The next batch is only read once on_batch returned.
+  void AsyncSayHelloStream(const HelloBatchRequest& request,
+                           BatchCallback on_batch, DoneCallback done) {
+    auto* call = new StreamCall(std::move(on_batch), std::move(done));
+    call->stub = AcquireStub();
+    if (compression_.Compress(request.ByteSizeLong())) {
+      call->context.set_compression_algorithm(compression_.algorithm);
+    }
+    call->reader = call->stub->get()->PrepareAsyncSayHelloStream(
+        &call->context, request, NextCq());
+    call->reader->StartCall(call->tag());
+  }
+
+  // Sends batches over one bidirectional stream, at most max_in_flight of
+  // them ahead of their replies: the window bounds what is buffered on both
+  // sides, and within it batches are pipelined instead of paying a round
+  // trip each. Callbacks as for AsyncSayHelloStream.
+  void AsyncSayHelloBidi(std::vector<HelloBatchRequest> batches,
+                         size_t max_in_flight, BatchCallback on_batch,
+                         DoneCallback done) {
+    auto* call = new BidiCall(std::move(batches), max_in_flight,
+                              std::move(on_batch), std::move(done),
+                              compression_);
+    call->Start(AcquireStub(), NextCq());
+  }
+
+  // For calls issued elsewhere on the channels and queues of this client,
+  // such as the coroutine calls of grpc_coro.h. Their tags must be GrpcTags,
+  // and every acquired stub is released once its call is done.
+  PooledStub* AcquireStub() {
+    auto size = stubs_.size();
+    PooledStub* picked;
+    if (size == 1) {
+      picked = stubs_[0].get();
+    } else if (selection_ == ChannelSelection::kRoundRobin) {
+      picked =
+          stubs_[next_stub_.fetch_add(1, std::memory_order_relaxed) % size]
+              .get();
+    } else {
+      // From a rotating start, so ties spread instead of piling on one.
+      auto start = next_stub_.fetch_add(1, std::memory_order_relaxed);
+      picked = stubs_[start % size].get();
+      for (size_t i = 1; i < size; ++i) {
+        auto* candidate = stubs_[(start + i) % size].get();
+        if (candidate->InFlight() < picked->InFlight()) picked = candidate;
+      }
+    }
+    picked->in_flight_.fetch_add(1, std::memory_order_relaxed);
+    return picked;
+  }
+
+  static void ReleaseStub(PooledStub* stub) {
+    stub->in_flight_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  CompletionQueue* NextCq() {
+    return cqs_[next_cq_.fetch_add(1, std::memory_order_relaxed) % cqs_.size()]
+        .get();
+  }
+
  private:
-  // Out of the passed in Channel comes the stub, stored here, our view of the
+  // struct for keeping state and data information
+  struct AsyncClientCall final : GrpcTag {
+    // Container for the data we expect from the server.
+    HelloReply reply;
+
+    // Context for the client. It could be used to convey extra information to
+    // the server and/or tweak certain RPC behaviors.
+    ClientContext context;
+
+    // Storage for the status of the RPC upon completion.
+    Status status;
+
+    std::unique_ptr<ClientAsyncResponseReader<HelloReply>> response_reader;
+
+    Callback callback;
+
+    PooledStub* stub = nullptr;
+
+    void complete(bool ok) override {
+      std::unique_ptr<AsyncClientCall> self(this);
+      ReleaseStub(stub);
+      // Verify that the request was completed successfully. Note that "ok"
+      // corresponds solely to the request for updates introduced by Finish().
+      GPR_ASSERT(ok);
+
+      callback(status, reply);
+    }
+  };
+
+  // Reads reply batches until the server ends the stream, then finishes.
+  struct StreamCall final : GrpcTag {
+    StreamCall(BatchCallback on_batch, DoneCallback done)
+        : on_batch(std::move(on_batch)), done(std::move(done)) {}
+
+    void complete(bool ok) override {
+      switch (state) {
+        case READ:
+          // Not ok once the stream is over, or when it never started.
+          if (!ok) {
+            state = FINISH;
+            reader->Finish(&status, tag());
+            return;
+          }
+          if (started) on_batch(reply);
+          started = true;
+          reader->Read(&reply, tag());
+          break;
+        case FINISH:
+          ReleaseStub(stub);
+          done(status);
+          delete this;
+          break;
+      }
+    }
+
+    enum State { READ, FINISH };
+
+    ClientContext context;
+    PooledStub* stub = nullptr;
+    std::unique_ptr<ClientAsyncReader<HelloBatchReply>> reader;
+    HelloBatchReply reply;
+    Status status;
+    BatchCallback on_batch;
+    DoneCallback done;
+    State state = READ;
+    bool started = false;
+  };
+
+  // Reads and writes are separate operations that may be outstanding at the
+  // same time, each with its own tag. Both complete on the one thread polling
+  // the call's queue, so the state needs no lock.
+  class BidiCall {
+   public:
+    BidiCall(std::vector<HelloBatchRequest> batches, size_t max_in_flight,
+             BatchCallback on_batch, DoneCallback done,
+             const CompressionOptions& compression)
+        : batches_(std::move(batches)),
+          max_in_flight_(std::max<size_t>(max_in_flight, 1)),
+          on_batch_(std::move(on_batch)),
+          done_(std::move(done)),
+          compression_(compression) {
+      // The algorithm applies to the whole call, small batches opt out one
+      // by one through their WriteOptions.
+      if (compression_.Enabled()) {
+        context_.set_compression_algorithm(compression_.algorithm);
+      }
+    }
+
+    void Start(PooledStub* stub, CompletionQueue* cq) {
+      stub_ = stub;
+      stream_ = stub_->get()->PrepareAsyncSayHelloBidi(&context_, cq);
+      // StartCall completes on the write tag, nothing else goes out before.
+      writing_ = true;
+      stream_->StartCall(write_tag_.tag());
+    }
+
+   private:
+    struct Tag final : GrpcTag {
+      Tag(BidiCall* call, void (BidiCall::*on_complete)(bool))
+          : call(call), on_complete(on_complete) {}
+      void complete(bool ok) override { (call->*on_complete)(ok); }
+      BidiCall* call;
+      void (BidiCall::*on_complete)(bool);
+    };
+
+    void OnWrite(bool ok) {
+      writing_ = false;
+      if (!started_) {
+        started_ = true;
+        if (ok) {
+          stream_->Read(&reply_, read_tag_.tag());
+        } else {
+          read_closed_ = true;
+        }
+      } else if (!ok || writes_done_) {
+        // A failed write means a broken stream, the pending read fails too.
+        write_closed_ = true;
+      }
+      Proceed();
+    }
+
+    void OnRead(bool ok) {
+      if (!ok) {
+        read_closed_ = true;
+      } else {
+        answered_++;
+        on_batch_(reply_);
+        stream_->Read(&reply_, read_tag_.tag());
+      }
+      Proceed();
+    }
+
+    void OnFinish(bool) {
+      ReleaseStub(stub_);
+      done_(status_);
+      delete this;
+    }
+
+    void Proceed() {
+      // The server ended the stream, there is no one left to write to.
+      if (read_closed_) write_closed_ = true;
+      if (!writing_ && !write_closed_) {
+        if (next_ == batches_.size()) {
+          writes_done_ = true;
+          writing_ = true;
+          stream_->WritesDone(write_tag_.tag());
+        } else if (next_ - answered_ < max_in_flight_) {
+          writing_ = true;
+          const auto& batch = batches_[next_++];
+          stream_->Write(batch,
+                         compression_.WriteOptionsFor(batch.ByteSizeLong()),
+                         write_tag_.tag());
+        }
+      }
+      if (read_closed_ && !writing_ && !finishing_) {
+        finishing_ = true;
+        stream_->Finish(&status_, finish_tag_.tag());
+      }
+    }
+
+    ClientContext context_;
+    PooledStub* stub_ = nullptr;
+    std::unique_ptr<ClientAsyncReaderWriter<HelloBatchRequest, HelloBatchReply>>
+        stream_;
+    std::vector<HelloBatchRequest> batches_;
+    size_t max_in_flight_;
+    BatchCallback on_batch_;
+    DoneCallback done_;
+    CompressionOptions compression_;
+    HelloBatchReply reply_;
+    Status status_;
+    Tag write_tag_{this, &BidiCall::OnWrite};
+    Tag read_tag_{this, &BidiCall::OnRead};
+    Tag finish_tag_{this, &BidiCall::OnFinish};
+    size_t next_ = 0;
+    size_t answered_ = 0;
+    bool started_ = false;
+    bool writing_ = false;
+    bool writes_done_ = false;
+    bool write_closed_ = false;
+    bool read_closed_ = false;
+    bool finishing_ = false;
+  };
+
+  // Loop while listening for completed responses, every tag completes itself.
+  static void AsyncCompleteRpc(CompletionQueue* cq) { drain_grpc_tags(cq); }
+
+  // Out of the passed in Channels come the stubs, stored here, our view of the
   // server's exposed services.
-  std::unique_ptr<Greeter::Stub> stub_;
-};
+  std::vector<std::unique_ptr<PooledStub>> stubs_;
+  ChannelSelection selection_;
+  CompressionOptions compression_;
+  std::atomic<size_t> next_stub_{0};
 
+  // The producer-consumer queues we use to communicate asynchronously with
+  // the gRPC runtime, each drained by one of threads_.
+  std::vector<std::unique_ptr<CompletionQueue>> cqs_;
+  std::vector<std::thread> threads_;
+  std::atomic<size_t> next_cq_{0};
+};
@@ -1,145 +1,450 @@
 #pragma once
 
+#include <pthread.h>
+
+#include <algorithm>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <grpc/support/log.h>
+#include <google/protobuf/arena.h>
 #include <grpcpp/grpcpp.h>
 
+#include "greeter_server.h"
+#include "grpc_compression.h"
+#include "grpc_tag.h"
 #include "helloworld.grpc.pb.h"
 
 using grpc::Server;
+using grpc::ServerAsyncReaderWriter;
 using grpc::ServerAsyncResponseWriter;
+using grpc::ServerAsyncWriter;
 using grpc::ServerBuilder;
 using grpc::ServerCompletionQueue;
 using grpc::ServerContext;
 using grpc::Status;
 using helloworld::Greeter;
+using helloworld::HelloBatchReply;
+using helloworld::HelloBatchRequest;
 using helloworld::HelloReply;
 using helloworld::HelloRequest;
 
-class ServerImpl final {
+class ServerImpl final : public GreeterServer {
  public:
-  ~ServerImpl() {
-    server_->Shutdown();
-    // Always shutdown the completion queue after the server.
-    cq_->Shutdown();
-  }
+  // One completion queue per polling thread: a single queue drained by one
+  // thread caps the server at one core, and several threads on one queue
+  // contend on it. Thread i is pinned to cpu_affinity[i % size] when given.
+  //
+  // Every queue keeps slots_per_cq RequestSayHello outstanding. A call that
+  // arrives while no slot is armed waits in the server until the polling
+  // thread re-arms one, so with a single slot a burst is taken one call per
+  // completion queue round trip. The streaming methods get as many slots.
+  explicit ServerImpl(std::string server_address = "0.0.0.0:50051",
+                      int num_cqs = 1,
+                      std::vector<int32_t> cpu_affinity = {},
+                      int slots_per_cq = 16)
+      : server_address_(std::move(server_address)),
+        num_cqs_(num_cqs),
+        cpu_affinity_(std::move(cpu_affinity)),
+        slots_per_cq_(slots_per_cq) {}
 
-  // There is no shutdown handling in this code.
-  void Run() {
-    std::string server_address("0.0.0.0:50051");
+  ~ServerImpl() override {
+    Shutdown();
+    Wait();
+    // CallData hold ServerContexts, release them before the server.
+    cq_states_.clear();
+  }
 
+  // Starts the server and its polling threads, then returns.
+  void Start() override {
     ServerBuilder builder;
     // Listen on the given address without any authentication mechanism.
-    builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
+    builder.AddListeningPort(server_address_, grpc::InsecureServerCredentials(),
+                             &selected_port_);
     // Register "service_" as the instance through which we'll communicate with
     // clients. In this case it corresponds to an *asynchronous* service.
     builder.RegisterService(&service_);
-    // Get hold of the completion queue used for the asynchronous communication
-    // with the gRPC runtime.
-    cq_ = builder.AddCompletionQueue();
+    // Get hold of the completion queues used for the asynchronous
+    // communication with the gRPC runtime.
+    for (int i = 0; i < num_cqs_; ++i) {
+      cqs_.emplace_back(builder.AddCompletionQueue());
+    }
     // Finally assemble the server.
     server_ = builder.BuildAndStart();
-    std::cout << "Server listening on " << server_address << std::endl;
+    std::cout << "Server listening on " << server_address_ << " with "
+              << num_cqs_ << " completion queues, " << slots_per_cq_
+              << " slots each" << std::endl;
 
-    // Proceed to the server's main loop.
-    HandleRpcs();
+    // Proceed to the server's main loop, one per completion queue.
+    for (int i = 0; i < num_cqs_; ++i) {
+      cq_states_.emplace_back(std::make_unique<CompletionQueueState>());
+      cq_states_.back()->cq = cqs_[i].get();
+      cq_states_.back()->compression = &compression_;
+      threads_.emplace_back(
+          [this, state = cq_states_.back().get()] { HandleRpcs(state); });
+      if (cpu_affinity_.empty()) continue;
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      CPU_SET(cpu_affinity_[i % cpu_affinity_.size()], &cpu_set);
+      pthread_setaffinity_np(threads_.back().native_handle(), sizeof(cpu_set_t),
+                             &cpu_set);
+    }
+  }
+
+  void Wait() override {
+    for (auto& thread : threads_) {
+      if (thread.joinable()) thread.join();
+    }
+  }
+
+  // Waits for in-flight calls up to the shutdown grace and shuts the
+  // completion queues down, the polling threads exit once their queue is
+  // drained.
+  void Shutdown() override {
+    std::call_once(shutdown_once_, [this] {
+      if (!server_) return;
+      server_->Shutdown(ShutdownDeadline());
+      // Always shutdown the completion queue after the server.
+      for (auto& cq : cqs_) cq->Shutdown();
+    });
+  }
+
+  int Port() const override { return selected_port_; }
+
+  // Replies and stream messages of at least options.min_bytes are compressed
+  // with an algorithm the client accepts. Call before Start().
+  void set_compression_options(const CompressionOptions& options) {
+    compression_ = options;
   }
 
  private:
-  // Class encompasing the state and logic needed to serve a request.
-  class CallData {
+  class CallData;
+
+  // Everything owned by one completion queue. Only its polling thread touches
+  // it, so the free list needs no lock.
+  struct CompletionQueueState {
+    ServerCompletionQueue* cq = nullptr;
+    const CompressionOptions* compression = nullptr;
+    // Finished CallData waiting to be re-armed.
+    std::vector<CallData*> free_list;
+    // Every CallData ever created for this queue, freed after the polling
+    // thread is joined.
+    std::vector<std::unique_ptr<CallData>> all;
+  };
+
+  // Class encompasing the state and logic needed to serve a request. A
+  // CallData is armed, serves one call, goes back to the free list of its
+  // queue and is armed again: in steady state no CallData, message or reply
+  // string is allocated, the messages live in an arena whose first block is
+  // part of the CallData and that is reset between calls.
+  class CallData final : public GrpcTag {
    public:
     // Take in the "service" instance (in this case representing an asynchronous
-    // server) and the completion queue "cq" used for asynchronous communication
-    // with the gRPC runtime.
-    CallData(Greeter::AsyncService* service, ServerCompletionQueue* cq)
-        : service_(service), cq_(cq), responder_(&ctx_), status_(CREATE) {
-      // Invoke the serving logic right away.
-      Proceed();
+    // server) and the state of the completion queue "cq" used for asynchronous
+    // communication with the gRPC runtime.
+    CallData(Greeter::AsyncService* service, CompletionQueueState* state)
+        : service_(service),
+          state_(state),
+          arena_(MakeArenaOptions(arena_block_)) {}
+
+    // Takes a CallData from the free list of the queue, or creates one, and
+    // requests the next SayHello with it.
+    static void Arm(Greeter::AsyncService* service,
+                    CompletionQueueState* state) {
+      CallData* call_data;
+      if (state->free_list.empty()) {
+        state->all.emplace_back(std::make_unique<CallData>(service, state));
+        call_data = state->all.back().get();
+      } else {
+        call_data = state->free_list.back();
+        state->free_list.pop_back();
+      }
+      call_data->Request();
     }
 
-    void Proceed() {
-      if (status_ == CREATE) {
-        // Make this instance progress to the PROCESS state.
-        status_ = PROCESS;
-
-        // As part of the initial CREATE state, we *request* that the system
-        // start processing SayHello requests. In this request, "this" acts are
-        // the tag uniquely identifying the request (so that different CallData
-        // instances can serve different requests concurrently), in this case
-        // the memory address of this CallData instance.
-        service_->RequestSayHello(&ctx_, &request_, &responder_, cq_, cq_,
-                                  this);
-      } else if (status_ == PROCESS) {
-        // Spawn a new CallData instance to serve new clients while we process
-        // the one for this CallData. The instance will deallocate itself as
-        // part of its FINISH state.
-        new CallData(service_, cq_);
-
-        // The actual processing.
-        std::string prefix("Hello ");
-        reply_.set_message(prefix + request_.name());
+    void complete(bool ok) override { Proceed(ok); }
+
+    void Proceed(bool ok) {
+      if (status_ == PROCESS) {
+        // The server is shutting down and this request slot was never
+        // matched with a call.
+        if (!ok) return;
+        // Arm another slot to serve new clients while we process the one for
+        // this CallData.
+        Arm(service_, state_);
+
+        // The actual processing, appended into the arena owned reply string.
+        auto* message = reply_->mutable_message();
+        message->append("Hello ");
+        message->append(request_->name());
+        // Set before Finish, which sends the initial metadata with the reply.
+        if (state_->compression->Compress(reply_->ByteSizeLong())) {
+          ctx_->set_compression_level(state_->compression->level);
+        }
 
         // And we are done! Let the gRPC runtime know we've finished, using the
         // memory address of this instance as the uniquely identifying tag for
         // the event.
         status_ = FINISH;
-        responder_.Finish(reply_, Status::OK, this);
+        responder_->Finish(*reply_, Status::OK, tag());
       } else {
         GPR_ASSERT(status_ == FINISH);
-        // Once in the FINISH state, deallocate ourselves (CallData).
-        delete this;
+        // Finished, or the call was cancelled before Finish went out: back to
+        // the free list instead of deallocating ourselves.
+        responder_.reset();
+        ctx_.reset();
+        state_->free_list.push_back(this);
       }
     }
 
    private:
+    static google::protobuf::ArenaOptions MakeArenaOptions(char* block) {
+      google::protobuf::ArenaOptions options;
+      options.initial_block = block;
+      options.initial_block_size = kArenaBlockSize;
+      return options;
+    }
+
+    void Request() {
+      // Drops the previous call's messages, the initial block is kept.
+      arena_.Reset();
+      request_ = google::protobuf::Arena::CreateMessage<HelloRequest>(&arena_);
+      reply_ = google::protobuf::Arena::CreateMessage<HelloReply>(&arena_);
+      // A ServerContext serves exactly one call, so it is rebuilt in place.
+      ctx_.emplace();
+      responder_.emplace(&*ctx_);
+      status_ = PROCESS;
+
+      // We *request* that the system start processing SayHello requests. In
+      // this request, "this" acts are the tag uniquely identifying the request
+      // (so that different CallData instances can serve different requests
+      // concurrently), in this case the memory address of this CallData
+      // instance.
+      service_->RequestSayHello(&*ctx_, request_, &*responder_, state_->cq,
+                                state_->cq, tag());
+    }
+
+    static constexpr size_t kArenaBlockSize = 1024;
+
     // The means of communication with the gRPC runtime for an asynchronous
     // server.
     Greeter::AsyncService* service_;
-    // The producer-consumer queue where for asynchronous server notifications.
-    ServerCompletionQueue* cq_;
+    // The completion queue this CallData is bound to, with its free list.
+    CompletionQueueState* state_;
     // Context for the rpc, allowing to tweak aspects of it such as the use
     // of compression, authentication, as well as to send metadata back to the
     // client.
-    ServerContext ctx_;
+    std::optional<ServerContext> ctx_;
 
+    // Backing store of arena_, declared first so it outlives the arena.
+    alignas(std::max_align_t) char arena_block_[kArenaBlockSize];
+    google::protobuf::Arena arena_;
     // What we get from the client.
-    HelloRequest request_;
+    HelloRequest* request_ = nullptr;
     // What we send back to the client.
-    HelloReply reply_;
+    HelloReply* reply_ = nullptr;
 
     // The means to get back to the client.
-    ServerAsyncResponseWriter<HelloReply> responder_;
+    std::optional<ServerAsyncResponseWriter<HelloReply>> responder_;
 
     // Let's implement a tiny state machine with the following states.
-    enum CallStatus { CREATE, PROCESS, FINISH };
-    CallStatus status_;  // The current serving state.
+    enum CallStatus { PROCESS, FINISH };
+    CallStatus status_ = PROCESS;  // The current serving state.
+  };
+
+  // SayHelloStream: greets every name of the request in reply batches of
+  // reply_batch_size. A single write is outstanding at a time and the next
+  // batch is built once the transport took the previous one, so a slow reader
+  // holds the server back through HTTP/2 flow control instead of replies
+  // piling up in memory. Streams are long, so these are allocated per call
+  // and delete themselves.
+  class StreamCallData final : public GrpcTag {
+   public:
+    StreamCallData(Greeter::AsyncService* service, CompletionQueueState* state)
+        : service_(service), state_(state), writer_(&ctx_) {
+      service_->RequestSayHelloStream(&ctx_, &request_, &writer_, state_->cq,
+                                      state_->cq, tag());
+    }
+
+    void complete(bool ok) override {
+      switch (status_) {
+        case REQUEST:
+          if (!ok) {
+            delete this;
+            return;
+          }
+          new StreamCallData(service_, state_);
+          // The level applies to the whole call, small messages opt out one
+          // by one through their WriteOptions.
+          if (state_->compression->Enabled()) {
+            ctx_.set_compression_level(state_->compression->level);
+          }
+          status_ = WRITE;
+          WriteNext();
+          break;
+        case WRITE:
+          // The client went away, no further write can succeed.
+          if (!ok) {
+            status_ = FINISH;
+            writer_.Finish(Status::CANCELLED, tag());
+            return;
+          }
+          WriteNext();
+          break;
+        case FINISH:
+          delete this;
+          break;
+      }
+    }
+
+   private:
+    void WriteNext() {
+      int names = request_.names_size();
+      if (next_ == names) {
+        status_ = FINISH;
+        writer_.Finish(Status::OK, tag());
+        return;
+      }
+      int batch = request_.reply_batch_size() > 0
+                      ? static_cast<int>(request_.reply_batch_size())
+                      : names;
+      int end = std::min(names, next_ + batch);
+      // Clear keeps the strings of the previous batch for reuse.
+      reply_.Clear();
+      for (; next_ < end; ++next_) {
+        auto* message = reply_.add_messages();
+        message->append("Hello ");
+        message->append(request_.names(next_));
+      }
+      if (next_ < names) {
+        writer_.Write(reply_, MakeWriteOptions(), tag());
+        return;
+      }
+      // The last batch goes out with the status, one completion less.
+      status_ = FINISH;
+      writer_.WriteAndFinish(reply_, MakeWriteOptions(), Status::OK, tag());
+    }
+
+    grpc::WriteOptions MakeWriteOptions() const {
+      return state_->compression->WriteOptionsFor(reply_.ByteSizeLong());
+    }
+
+    enum CallStatus { REQUEST, WRITE, FINISH };
+
+    Greeter::AsyncService* service_;
+    CompletionQueueState* state_;
+    ServerContext ctx_;
+    HelloBatchRequest request_;
+    HelloBatchReply reply_;
+    ServerAsyncWriter<HelloBatchReply> writer_;
+    int next_ = 0;
+    CallStatus status_ = REQUEST;
+  };
+
+  // SayHelloBidi: reads a batch, writes its greetings, reads the next one. The
+  // next read is only issued once the reply was written, so a client that
+  // does not read its replies is stopped by flow control on its writes.
+  class BidiCallData final : public GrpcTag {
+   public:
+    BidiCallData(Greeter::AsyncService* service, CompletionQueueState* state)
+        : service_(service), state_(state), stream_(&ctx_) {
+      service_->RequestSayHelloBidi(&ctx_, &stream_, state_->cq, state_->cq,
+                                    tag());
+    }
+
+    void complete(bool ok) override {
+      switch (status_) {
+        case REQUEST:
+          if (!ok) {
+            delete this;
+            return;
+          }
+          new BidiCallData(service_, state_);
+          if (state_->compression->Enabled()) {
+            ctx_.set_compression_level(state_->compression->level);
+          }
+          status_ = READ;
+          stream_.Read(&request_, tag());
+          break;
+        case READ:
+          // The client is done writing.
+          if (!ok) {
+            status_ = FINISH;
+            stream_.Finish(Status::OK, tag());
+            return;
+          }
+          reply_.Clear();
+          for (const auto& name : request_.names()) {
+            auto* message = reply_.add_messages();
+            message->append("Hello ");
+            message->append(name);
+          }
+          status_ = WRITE;
+          stream_.Write(
+              reply_,
+              state_->compression->WriteOptionsFor(reply_.ByteSizeLong()),
+              tag());
+          break;
+        case WRITE:
+          if (!ok) {
+            status_ = FINISH;
+            stream_.Finish(Status::CANCELLED, tag());
+            return;
+          }
+          status_ = READ;
+          stream_.Read(&request_, tag());
+          break;
+        case FINISH:
+          delete this;
+          break;
+      }
+    }
+
+   private:
+    enum CallStatus { REQUEST, READ, WRITE, FINISH };
+
+    Greeter::AsyncService* service_;
+    CompletionQueueState* state_;
+    ServerContext ctx_;
+    HelloBatchRequest request_;
+    HelloBatchReply reply_;
+    ServerAsyncReaderWriter<HelloBatchReply, HelloBatchRequest> stream_;
+    CallStatus status_ = REQUEST;
   };
 
-  // This can be run in multiple threads if needed.
-  void HandleRpcs() {
-    // Spawn a new CallData instance to serve new clients.
-    new CallData(&service_, cq_.get());
-    void* tag;  // uniquely identifies a request.
-    bool ok;
-    while (true) {
-      // Block waiting to read the next event from the completion queue. The
-      // event is uniquely identified by its tag, which in this case is the
-      // memory address of a CallData instance.
-      // The return value of Next should always be checked. This return value
-      // tells us whether there is any kind of event or cq_ is shutting down.
-      GPR_ASSERT(cq_->Next(&tag, &ok));
-      GPR_ASSERT(ok);
-      static_cast<CallData*>(tag)->Proceed();
+  // Runs on the polling thread of state->cq, and only touches CallData bound
+  // to it.
+  void HandleRpcs(CompletionQueueState* state) {
+    // Arm the request slots of this queue, each one re-arms a replacement as
+    // soon as it is matched with a call.
+    for (int i = 0; i < slots_per_cq_; ++i) {
+      CallData::Arm(&service_, state);
+      new StreamCallData(&service_, state);
+      new BidiCallData(&service_, state);
     }
+    // Block waiting to read the next event from the completion queue. Every
+    // tag is a GrpcTag that carries on its own call. Returns once the queue
+    // is shut down and fully drained.
+    drain_grpc_tags(state->cq);
   }
 
-  std::unique_ptr<ServerCompletionQueue> cq_;
+  std::string server_address_;
+  int num_cqs_;
+  std::vector<int32_t> cpu_affinity_;
+  int slots_per_cq_;
+  CompressionOptions compression_;
+  int selected_port_ = 0;
+  std::vector<std::unique_ptr<ServerCompletionQueue>> cqs_;
+  // Declared after cqs_ and destroyed before them.
+  std::vector<std::unique_ptr<CompletionQueueState>> cq_states_;
+  std::vector<std::thread> threads_;
   Greeter::AsyncService service_;
   std::unique_ptr<Server> server_;
+  std::once_flag shutdown_once_;
 };
 
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <grpcpp/grpcpp.h>
+
+#include "greeter_server.h"
+#include "grpc_compression.h"
+#include "helloworld.grpc.pb.h"
+
+// The Greeter service on the callback API. gRPC runs the reactors on its own
+// thread pool, so there are no completion queues, polling threads or tags
+// here, at the price of no control over threading or pinning. Reactions run
+// on gRPC's threads and must not block.
+class CallbackServerImpl final : public GreeterServer {
+ public:
+  explicit CallbackServerImpl(std::string server_address = "0.0.0.0:50051")
+      : server_address_(std::move(server_address)) {}
+
+  ~CallbackServerImpl() override {
+    Shutdown();
+    Wait();
+  }
+
+  void Start() override {
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort(server_address_, grpc::InsecureServerCredentials(),
+                             &selected_port_);
+    builder.RegisterService(&service_);
+    server_ = builder.BuildAndStart();
+    std::cout << "Callback server listening on " << server_address_
+              << std::endl;
+  }
+
+  void Wait() override {
+    if (server_) server_->Wait();
+  }
+
+  void Shutdown() override {
+    std::call_once(shutdown_once_, [this] {
+      if (server_) server_->Shutdown(ShutdownDeadline());
+    });
+  }
+
+  int Port() const override { return selected_port_; }
+
+  // As ServerImpl::set_compression_options, call before Start().
+  void set_compression_options(const CompressionOptions& options) {
+    service_.set_compression_options(options);
+  }
+
+ private:
+  // Same batching as ServerImpl's StreamCallData: one write outstanding, the
+  // next batch built in OnWriteDone.
+  class StreamReactor final
+      : public grpc::ServerWriteReactor<helloworld::HelloBatchReply> {
+   public:
+    StreamReactor(grpc::CallbackServerContext* context,
+                  const helloworld::HelloBatchRequest* request,
+                  const CompressionOptions* compression)
+        : request_(request), compression_(compression) {
+      if (compression_->Enabled()) {
+        context->set_compression_level(compression_->level);
+      }
+      WriteNext();
+    }
+
+    void OnWriteDone(bool ok) override {
+      if (!ok) {
+        Finish(grpc::Status::CANCELLED);
+        return;
+      }
+      WriteNext();
+    }
+
+    void OnDone() override { delete this; }
+
+   private:
+    void WriteNext() {
+      int names = request_->names_size();
+      if (next_ == names) {
+        Finish(grpc::Status::OK);
+        return;
+      }
+      int batch = request_->reply_batch_size() > 0
+                      ? static_cast<int>(request_->reply_batch_size())
+                      : names;
+      int end = std::min(names, next_ + batch);
+      reply_.Clear();
+      for (; next_ < end; ++next_) {
+        auto* message = reply_.add_messages();
+        message->append("Hello ");
+        message->append(request_->names(next_));
+      }
+      auto options = compression_->WriteOptionsFor(reply_.ByteSizeLong());
+      if (next_ < names) {
+        StartWrite(&reply_, options);
+        return;
+      }
+      StartWriteAndFinish(&reply_, options, grpc::Status::OK);
+    }
+
+    const helloworld::HelloBatchRequest* request_;
+    const CompressionOptions* compression_;
+    helloworld::HelloBatchReply reply_;
+    int next_ = 0;
+  };
+
+  // Read a batch, write its greetings, read the next one.
+  class BidiReactor final
+      : public grpc::ServerBidiReactor<helloworld::HelloBatchRequest,
+                                       helloworld::HelloBatchReply> {
+   public:
+    BidiReactor(grpc::CallbackServerContext* context,
+                const CompressionOptions* compression)
+        : compression_(compression) {
+      if (compression_->Enabled()) {
+        context->set_compression_level(compression_->level);
+      }
+      StartRead(&request_);
+    }
+
+    void OnReadDone(bool ok) override {
+      // The client is done writing.
+      if (!ok) {
+        Finish(grpc::Status::OK);
+        return;
+      }
+      reply_.Clear();
+      for (const auto& name : request_.names()) {
+        auto* message = reply_.add_messages();
+        message->append("Hello ");
+        message->append(name);
+      }
+      StartWrite(&reply_,
+                 compression_->WriteOptionsFor(reply_.ByteSizeLong()));
+    }
+
+    void OnWriteDone(bool ok) override {
+      if (!ok) {
+        Finish(grpc::Status::CANCELLED);
+        return;
+      }
+      StartRead(&request_);
+    }
+
+    void OnDone() override { delete this; }
+
+   private:
+    const CompressionOptions* compression_;
+    helloworld::HelloBatchRequest request_;
+    helloworld::HelloBatchReply reply_;
+  };
+
+  class GreeterServiceImpl final : public helloworld::Greeter::CallbackService {
+   public:
+    void set_compression_options(const CompressionOptions& options) {
+      compression_ = options;
+    }
+
+   private:
+    grpc::ServerUnaryReactor* SayHello(
+        grpc::CallbackServerContext* context,
+        const helloworld::HelloRequest* request,
+        helloworld::HelloReply* reply) override {
+      auto* message = reply->mutable_message();
+      message->append("Hello ");
+      message->append(request->name());
+      if (compression_.Compress(reply->ByteSizeLong())) {
+        context->set_compression_level(compression_.level);
+      }
+      auto* reactor = context->DefaultReactor();
+      reactor->Finish(grpc::Status::OK);
+      return reactor;
+    }
+
+    grpc::ServerWriteReactor<helloworld::HelloBatchReply>* SayHelloStream(
+        grpc::CallbackServerContext* context,
+        const helloworld::HelloBatchRequest* request) override {
+      return new StreamReactor(context, request, &compression_);
+    }
+
+    grpc::ServerBidiReactor<helloworld::HelloBatchRequest,
+                            helloworld::HelloBatchReply>*
+    SayHelloBidi(grpc::CallbackServerContext* context) override {
+      return new BidiReactor(context, &compression_);
+    }
+
+    CompressionOptions compression_;
+  };
+
+  std::string server_address_;
+  int selected_port_ = 0;
+  GreeterServiceImpl service_;
+  std::unique_ptr<grpc::Server> server_;
+  std::once_flag shutdown_once_;
+};
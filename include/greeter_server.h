@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+
+// What test.cpp and the benchmarks need from a Greeter server, whichever gRPC
+// API it is built on.
+class GreeterServer {
+ public:
+  virtual ~GreeterServer() = default;
+
+  // Starts the server and returns.
+  virtual void Start() = 0;
+  // Blocks until the server was shut down.
+  virtual void Wait() = 0;
+  // Waits for in-flight calls up to the shutdown grace, cancels the ones still
+  // running after it, then stops serving.
+  virtual void Shutdown() = 0;
+  // The bound port, useful with "host:0".
+  virtual int Port() const = 0;
+
+  // Starts the server and blocks until Shutdown() is called from another
+  // thread.
+  void Run() {
+    Start();
+    Wait();
+  }
+
+  // Without a deadline an idle bidi stream would hold Shutdown() forever.
+  void set_shutdown_grace(std::chrono::milliseconds grace) {
+    shutdown_grace_ = grace;
+  }
+
+ protected:
+  std::chrono::system_clock::time_point ShutdownDeadline() const {
+    return std::chrono::system_clock::now() + shutdown_grace_;
+  }
+
+ private:
+  std::chrono::milliseconds shutdown_grace_{std::chrono::seconds(5)};
+};
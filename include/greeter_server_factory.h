@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "greeter_async_server.h"
+#include "greeter_callback_server.h"
+#include "greeter_server.h"
+
+enum class GreeterServerMode {
+  // ServerImpl: completion queues drained by our own pinned threads.
+  kCompletionQueue,
+  // CallbackServerImpl: reactors on gRPC's internal thread pool.
+  kCallback,
+};
+
+// "cq" or "callback".
+inline GreeterServerMode ParseGreeterServerMode(const std::string& name) {
+  if (name == "cq") return GreeterServerMode::kCompletionQueue;
+  if (name == "callback") return GreeterServerMode::kCallback;
+  throw std::invalid_argument("unknown greeter server mode: " + name);
+}
+
+// num_cqs only applies to the completion queue server.
+inline std::unique_ptr<GreeterServer> MakeGreeterServer(
+    GreeterServerMode mode, std::string server_address = "0.0.0.0:50051",
+    int num_cqs = 1) {
+  switch (mode) {
+    case GreeterServerMode::kCallback:
+      return std::make_unique<CallbackServerImpl>(std::move(server_address));
+    case GreeterServerMode::kCompletionQueue:
+      break;
+  }
+  return std::make_unique<ServerImpl>(std::move(server_address), num_cqs);
+}
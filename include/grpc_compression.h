@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+#include <grpc/compression.h>
+#include <grpcpp/grpcpp.h>
+
+// Per-message compression above a size threshold, shared by the Greeter
+// servers and GreeterClient. Below the threshold gzip costs CPU for little
+// or no gain, a few dozen bytes can even grow.
+struct CompressionOptions {
+  // Messages of fewer serialized bytes go out as they are, 0 turns
+  // compression off altogether.
+  size_t min_bytes = 0;
+  // Responses: the server turns the level into an algorithm out of those the
+  // client announced in grpc-accept-encoding, so the client is never sent
+  // anything it cannot decode.
+  grpc_compression_level level = GRPC_COMPRESS_LEVEL_HIGH;
+  // Requests: a client has to name the algorithm before it has heard from
+  // the server. Every gRPC server accepts gzip unless it was disabled.
+  grpc_compression_algorithm algorithm = GRPC_COMPRESS_GZIP;
+
+  bool Enabled() const { return min_bytes > 0; }
+  bool Compress(size_t bytes) const { return Enabled() && bytes >= min_bytes; }
+
+  // For a stream whose compression is on, per message.
+  grpc::WriteOptions WriteOptionsFor(size_t bytes) const {
+    grpc::WriteOptions options;
+    if (!Compress(bytes)) options.set_no_compression();
+    return options;
+  }
+};
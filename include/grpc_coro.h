@@ -0,0 +1,171 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <folly/Executor.h>
+#include <folly/experimental/coro/Task.h>
+
+#include <greeter_async_client.h>
+#include <grpc_tag.h>
+
+// SayHello served by coroutines instead of a tag state machine. Every armed slot is a serve() coroutine that awaits
+// its RequestSayHello, arms a replacement, runs the handler and awaits its Finish. The handler is a
+// folly::coro::Task and may co_await MySQL, Redis or another RPC, the completion queue thread is not held meanwhile.
+//
+// The polling threads only resume coroutines, which then continue on executor: with folly::InlineExecutor the
+// handler runs on the polling thread like ServerImpl's CallData, with a thread pool it runs there.
+class CoroGreeterServer final {
+public:
+	using Handler = std::function<folly::coro::Task<grpc::Status>(grpc::ServerContext&, const HelloRequest&, HelloReply&)>;
+
+	CoroGreeterServer(Handler handler, folly::Executor* executor, std::string address = "0.0.0.0:50051", int32_t num_cqs = 1,
+		int32_t slots_per_cq = 16)
+		: m_handler(std::move(handler))
+		, m_executor(executor)
+		, m_address(std::move(address))
+		, m_num_cqs(num_cqs)
+		, m_slots_per_cq(slots_per_cq) {
+	}
+
+	~CoroGreeterServer() {
+		shutdown();
+		wait();
+	}
+
+	CoroGreeterServer(const CoroGreeterServer&) = delete;
+	CoroGreeterServer& operator=(const CoroGreeterServer&) = delete;
+
+	void start() {
+		grpc::ServerBuilder builder;
+		builder.AddListeningPort(m_address, grpc::InsecureServerCredentials(), &m_port);
+		builder.RegisterService(&m_service);
+		for (int32_t i = 0; i < m_num_cqs; ++i)
+			m_cqs.emplace_back(builder.AddCompletionQueue());
+		m_server = builder.BuildAndStart();
+		if (!m_server)
+			throw std::runtime_error(fmt::format("grpc server failed to listen on {}", m_address));
+		spdlog::info("coroutine grpc server listening on {} with {} completion queues, {} slots each", m_address, m_num_cqs, m_slots_per_cq);
+		for (auto& cq : m_cqs) {
+			for (int32_t i = 0; i < m_slots_per_cq; ++i)
+				arm(cq.get());
+			m_threads.emplace_back([cq = cq.get()] { drain_grpc_tags(cq); });
+		}
+	}
+
+	// Unmatched slots complete with ok == false, calls in flight finish first.
+	void shutdown() {
+		std::call_once(m_shutdown_once, [this] {
+			if (!m_server)
+				return;
+			{
+				// no RequestSayHello may reach a completion queue after its Shutdown
+				std::unique_lock<std::shared_mutex> lk(m_shutdown_mutex);
+				m_shutting_down = true;
+			}
+			m_server->Shutdown();
+			for (auto& cq : m_cqs)
+				cq->Shutdown();
+		});
+	}
+
+	// Joins the polling threads, then waits for the coroutines they handed to the executor.
+	void wait() {
+		for (auto& thread : m_threads) {
+			if (thread.joinable())
+				thread.join();
+		}
+		std::unique_lock<std::mutex> lk(m_live_mutex);
+		m_live_cv.wait(lk, [this] { return m_live == 0; });
+	}
+
+	int port() const { return m_port; }
+
+private:
+	void arm(grpc::ServerCompletionQueue* cq) {
+		{
+			std::lock_guard<std::mutex> lk(m_live_mutex);
+			m_live++;
+		}
+		serve(cq).scheduleOn(m_executor).start();
+	}
+
+	void finished() {
+		std::lock_guard<std::mutex> lk(m_live_mutex);
+		if (--m_live == 0)
+			m_live_cv.notify_all();
+	}
+
+	folly::coro::Task<void> serve(grpc::ServerCompletionQueue* cq) {
+		grpc::ServerContext context;
+		HelloRequest request;
+		HelloReply reply;
+		grpc::ServerAsyncResponseWriter<HelloReply> responder(&context);
+		auto matched = co_await async_grpc([&](void* tag) {
+			std::shared_lock<std::shared_mutex> lk(m_shutdown_mutex);
+			if (m_shutting_down)
+				return false;
+			m_service.RequestSayHello(&context, &request, &responder, cq, cq, tag);
+			return true;
+		});
+		if (!matched) {
+			finished();
+			co_return;
+		}
+		// the replacement slot goes out before the handler, however long it takes
+		arm(cq);
+		grpc::Status status;
+		try {
+			status = co_await m_handler(context, request, reply);
+		} catch (const std::exception& e) {
+			spdlog::error("SayHello handler: {}", e.what());
+			status = grpc::Status(grpc::StatusCode::INTERNAL, e.what());
+		}
+		// ok == false only means the call was cancelled, there is nothing left to do either way
+		co_await async_grpc([&](void* tag) { responder.Finish(reply, status, tag); });
+		finished();
+		co_return;
+	}
+
+	Handler m_handler;
+	folly::Executor* m_executor;
+	std::string m_address;
+	int32_t m_num_cqs;
+	int32_t m_slots_per_cq;
+	int m_port{0};
+	Greeter::AsyncService m_service;
+	std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> m_cqs;
+	std::unique_ptr<grpc::Server> m_server;
+	std::vector<std::thread> m_threads;
+	std::once_flag m_shutdown_once;
+	std::shared_mutex m_shutdown_mutex;
+	bool m_shutting_down{false};
+	std::mutex m_live_mutex;
+	std::condition_variable m_live_cv;
+	int64_t m_live{0};
+};
+
+// One SayHello on the completion queues of client, the coroutine resumes once the reply is in.
+inline folly::coro::Task<std::pair<grpc::Status, HelloReply>> async_say_hello(GreeterClient& client, HelloRequest request) noexcept {
+	grpc::ClientContext context;
+	HelloReply reply;
+	grpc::Status status;
+	auto stub = client.AcquireStub();
+	auto reader = stub->get()->PrepareAsyncSayHello(&context, request, client.NextCq());
+	reader->StartCall();
+	co_await async_grpc([&](void* tag) { reader->Finish(&reply, &status, tag); });
+	GreeterClient::ReleaseStub(stub);
+	co_return std::make_pair(std::move(status), std::move(reply));
+}
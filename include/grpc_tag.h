@@ -0,0 +1,66 @@
+#pragma once
+
+#include <coroutine>
+#include <type_traits>
+#include <utility>
+
+#include <grpcpp/grpcpp.h>
+
+// Completion queue tag with its own completion, so one polling loop drives callbacks and coroutines alike. Every
+// tag put on a queue drained by drain_grpc_tags must be a GrpcTag.
+class GrpcTag {
+public:
+	virtual ~GrpcTag() = default;
+	virtual void complete(bool ok) = 0;
+
+	// what to hand to gRPC, drain_grpc_tags casts it back to a GrpcTag
+	void* tag() { return this; }
+};
+
+// One completion queue operation as an awaitable: start(tag) issues it (Finish, Read, Write, RequestXxx) with this
+// awaiter as the tag, and the coroutine resumes with the ok flag once the tag comes out of the queue. start may
+// return false to skip the operation, the coroutine then continues right away with ok == false.
+template <typename Start>
+class GrpcTagAwaiter final : public GrpcTag {
+public:
+	explicit GrpcTagAwaiter(Start start)
+		: m_start(std::move(start)) {
+	}
+
+	bool await_ready() const noexcept { return false; }
+	bool await_suspend(std::coroutine_handle<> handle) {
+		m_handle = handle;
+		// the operation can complete, and the coroutine resume and destroy this awaiter, on the polling thread before
+		// start returns, so nothing of this object may be touched after the call
+		auto start = std::move(m_start);
+		if constexpr (std::is_same_v<decltype(start(tag())), bool>)
+			return start(tag());
+		else
+			start(tag());
+		return true;
+	}
+	bool await_resume() noexcept { return m_ok; }
+
+	void complete(bool ok) override {
+		m_ok = ok;
+		m_handle.resume();
+	}
+
+private:
+	Start m_start;
+	std::coroutine_handle<> m_handle;
+	bool m_ok{false};
+};
+
+template <typename Start>
+inline GrpcTagAwaiter<Start> async_grpc(Start start) {
+	return GrpcTagAwaiter<Start>{std::move(start)};
+}
+
+// polling loop, returns once cq is shut down and drained
+inline void drain_grpc_tags(grpc::CompletionQueue* cq) {
+	void* tag;
+	bool ok;
+	while (cq->Next(&tag, &ok))
+		static_cast<GrpcTag*>(tag)->complete(ok);
+}
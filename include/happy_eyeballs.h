@@ -0,0 +1,184 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+struct HappyEyeballsOptions {
+	// RFC 8305 recommends 250ms between attempts
+	std::chrono::milliseconds attempt_delay{250};
+	std::chrono::milliseconds connect_timeout{std::chrono::seconds(10)};
+};
+
+// Process wide memory of the endpoint that won the last race per host:port, tried first next time.
+class EndpointCache final {
+public:
+	static EndpointCache& instance() {
+		static EndpointCache cache;
+		return cache;
+	}
+
+	void remember(const std::string& key, const boost::asio::ip::tcp::endpoint& endpoint) {
+		std::lock_guard<std::mutex> lk(m_mutex);
+		m_fastest[key] = endpoint;
+	}
+
+	void forget(const std::string& key) {
+		std::lock_guard<std::mutex> lk(m_mutex);
+		m_fastest.erase(key);
+	}
+
+	std::optional<boost::asio::ip::tcp::endpoint> fastest(const std::string& key) {
+		std::lock_guard<std::mutex> lk(m_mutex);
+		if (auto it = m_fastest.find(key); it != m_fastest.end())
+			return it->second;
+		return std::nullopt;
+	}
+
+private:
+	std::mutex m_mutex;
+	std::unordered_map<std::string, boost::asio::ip::tcp::endpoint> m_fastest;
+};
+
+// Happy eyeballs (RFC 8305): instead of trying the resolved endpoints one after another, which costs a full connect
+// timeout for every dead address in front, a new attempt starts every attempt_delay, or as soon as the previous
+// one fails, while the earlier ones keep going. The first to connect wins and the others are closed. Address
+// families are interleaved so a broken IPv6 path does not delay IPv4, and the last winner is tried first.
+//
+// All completions run on the socket's executor, which like everywhere else in this repo is one io_context thread.
+class HappyEyeballsConnect final : public std::enable_shared_from_this<HappyEyeballsConnect> {
+public:
+	using Handler = std::function<void(boost::system::error_code, boost::asio::ip::tcp::endpoint)>;
+
+	HappyEyeballsConnect(boost::asio::ip::tcp::socket& socket, const boost::asio::ip::tcp::resolver::results_type& results,
+		HappyEyeballsOptions options, Handler handler)
+		: m_socket(socket)
+		, m_options(options)
+		, m_handler(std::move(handler))
+		, m_delay_timer(socket.get_executor())
+		, m_deadline_timer(socket.get_executor()) {
+		if (!results.empty())
+			m_key = results.begin()->host_name() + ":" + results.begin()->service_name();
+		order(results);
+	}
+
+	void start() {
+		if (m_endpoints.empty()) {
+			boost::asio::post(m_socket.get_executor(), [self = shared_from_this()] { self->finish(boost::asio::error::host_not_found, {}); });
+			return;
+		}
+		m_deadline_timer.expires_after(m_options.connect_timeout);
+		m_deadline_timer.async_wait([self = shared_from_this()](const boost::system::error_code& ec) {
+			if (!ec)
+				self->finish(boost::asio::error::timed_out, {});
+		});
+		startNext();
+	}
+
+private:
+	void order(const boost::asio::ip::tcp::resolver::results_type& results) {
+		std::vector<boost::asio::ip::tcp::endpoint> first_family;
+		std::vector<boost::asio::ip::tcp::endpoint> other_family;
+		auto fastest = EndpointCache::instance().fastest(m_key);
+		for (const auto& entry : results) {
+			auto endpoint = entry.endpoint();
+			if (fastest && endpoint == fastest.value())
+				continue;
+			if (first_family.empty() || endpoint.protocol() == first_family.front().protocol())
+				first_family.emplace_back(endpoint);
+			else
+				other_family.emplace_back(endpoint);
+		}
+		// only a winner that is still in the dns answer
+		if (fastest && results.size() != first_family.size() + other_family.size()) {
+			m_endpoints.emplace_back(fastest.value());
+			m_cached_first = true;
+		}
+		for (std::size_t i = 0; i < std::max(first_family.size(), other_family.size()); ++i) {
+			if (i < first_family.size())
+				m_endpoints.emplace_back(first_family[i]);
+			if (i < other_family.size())
+				m_endpoints.emplace_back(other_family[i]);
+		}
+	}
+
+	void startNext() {
+		if (m_done || m_next == m_endpoints.size())
+			return;
+		auto index = m_next++;
+		m_attempts.emplace_back(std::make_unique<boost::asio::ip::tcp::socket>(m_socket.get_executor()));
+		m_running++;
+		m_attempts.back()->async_connect(m_endpoints[index], [self = shared_from_this(), attempt = m_attempts.size() - 1, index](const boost::system::error_code& ec) {
+			self->onConnect(attempt, index, ec);
+		});
+		if (m_next == m_endpoints.size())
+			return;
+		m_delay_timer.expires_after(m_options.attempt_delay);
+		m_delay_timer.async_wait([self = shared_from_this()](const boost::system::error_code& ec) {
+			if (!ec)
+				self->startNext();
+		});
+	}
+
+	void onConnect(std::size_t attempt, std::size_t index, const boost::system::error_code& ec) {
+		m_running--;
+		if (m_done)
+			return;
+		if (ec) {
+			m_last_ec = ec;
+			boost::system::error_code ignore_ec;
+			m_attempts[attempt]->close(ignore_ec);
+			if (index == 0 && m_cached_first)
+				EndpointCache::instance().forget(m_key);
+			// a failure does not wait for the delay
+			if (m_next < m_endpoints.size())
+				startNext();
+			else if (m_running == 0)
+				finish(m_last_ec, {});
+			return;
+		}
+		m_socket = std::move(*m_attempts[attempt]);
+		if (!m_key.empty())
+			EndpointCache::instance().remember(m_key, m_endpoints[index]);
+		finish({}, m_endpoints[index]);
+	}
+
+	void finish(boost::system::error_code ec, boost::asio::ip::tcp::endpoint endpoint) {
+		if (m_done)
+			return;
+		m_done = true;
+		m_delay_timer.cancel();
+		m_deadline_timer.cancel();
+		boost::system::error_code ignore_ec;
+		for (auto& attempt : m_attempts)
+			attempt->close(ignore_ec);
+		m_handler(ec, endpoint);
+	}
+
+	boost::asio::ip::tcp::socket& m_socket;
+	HappyEyeballsOptions m_options;
+	Handler m_handler;
+	boost::asio::steady_timer m_delay_timer;
+	boost::asio::steady_timer m_deadline_timer;
+	std::string m_key;
+	std::vector<boost::asio::ip::tcp::endpoint> m_endpoints;
+	std::vector<std::unique_ptr<boost::asio::ip::tcp::socket>> m_attempts;
+	std::size_t m_next{0};
+	std::size_t m_running{0};
+	bool m_cached_first{false};
+	bool m_done{false};
+	boost::system::error_code m_last_ec{boost::asio::error::host_not_found};
+};
+
+// handler(error_code, endpoint) is called once, with socket connected on success
+inline void async_connect_happy_eyeballs(boost::asio::ip::tcp::socket& socket, const boost::asio::ip::tcp::resolver::results_type& results,
+	HappyEyeballsOptions options, HappyEyeballsConnect::Handler handler) {
+	std::make_shared<HappyEyeballsConnect>(socket, results, options, std::move(handler))->start();
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// High dynamic range histogram (same bucket layout as HdrHistogram_c): values are kept with a fixed number of
+// significant decimal digits over the whole [lowest, highest] range, so p99.99 of a latency distribution is as
+// precise as p50 while recording stays a couple of shifts and an increment.
+class HdrHistogram final {
+public:
+	HdrHistogram(int64_t lowest_trackable_value, int64_t highest_trackable_value, int32_t significant_figures)
+		: m_lowest_trackable_value(lowest_trackable_value)
+		, m_highest_trackable_value(highest_trackable_value) {
+		if (lowest_trackable_value < 1 || significant_figures < 1 || significant_figures > 5 || lowest_trackable_value * 2 > highest_trackable_value)
+			throw std::invalid_argument("HdrHistogram invalid arguments");
+		int64_t largest_value_with_single_unit_resolution = 2 * static_cast<int64_t>(std::pow(10, significant_figures));
+		m_unit_magnitude = static_cast<int32_t>(std::floor(std::log2(lowest_trackable_value)));
+		m_sub_bucket_count_magnitude = static_cast<int32_t>(std::ceil(std::log2(largest_value_with_single_unit_resolution)));
+		m_sub_bucket_half_count_magnitude = m_sub_bucket_count_magnitude - 1;
+		m_sub_bucket_count = int64_t{1} << m_sub_bucket_count_magnitude;
+		m_sub_bucket_half_count = m_sub_bucket_count / 2;
+		m_sub_bucket_mask = (m_sub_bucket_count - 1) << m_unit_magnitude;
+		int64_t smallest_untrackable_value = m_sub_bucket_count << m_unit_magnitude;
+		int32_t bucket_count = 1;
+		while (smallest_untrackable_value <= highest_trackable_value) {
+			if (smallest_untrackable_value > INT64_MAX / 2) {
+				++bucket_count;
+				break;
+			}
+			smallest_untrackable_value <<= 1;
+			++bucket_count;
+		}
+		m_counts.resize((bucket_count + 1) * m_sub_bucket_half_count);
+	}
+
+	// values outside the trackable range are clamped
+	void record(int64_t value, int64_t count = 1) {
+		value = std::clamp(value, m_lowest_trackable_value, m_highest_trackable_value);
+		m_counts[countsIndexFor(value)] += count;
+		m_total_count += count;
+		m_min = std::min(m_min, value);
+		m_max = std::max(m_max, value);
+		m_sum += static_cast<double>(value) * count;
+	}
+
+	void merge(const HdrHistogram& other) {
+		if (other.m_counts.size() != m_counts.size())
+			throw std::invalid_argument("HdrHistogram merge with different layout");
+		for (std::size_t i = 0; i < m_counts.size(); ++i)
+			m_counts[i] += other.m_counts[i];
+		m_total_count += other.m_total_count;
+		m_min = std::min(m_min, other.m_min);
+		m_max = std::max(m_max, other.m_max);
+		m_sum += other.m_sum;
+	}
+
+	void reset() {
+		std::fill(m_counts.begin(), m_counts.end(), 0);
+		m_total_count = 0;
+		m_min = INT64_MAX;
+		m_max = 0;
+		m_sum = 0;
+	}
+
+	// percentile in [0, 100], returns the highest value equivalent to the bucket the percentile falls into
+	int64_t valueAtPercentile(double percentile) const {
+		if (m_total_count == 0)
+			return 0;
+		auto count_at_percentile = std::max<int64_t>(1, std::llround(std::min(percentile, 100.0) / 100.0 * m_total_count));
+		int64_t total = 0;
+		for (std::size_t i = 0; i < m_counts.size(); ++i) {
+			total += m_counts[i];
+			if (total >= count_at_percentile)
+				return std::min(highestEquivalentValue(valueFromIndex(static_cast<int32_t>(i))), m_max);
+		}
+		return m_max;
+	}
+
+	int64_t totalCount() const { return m_total_count; }
+	int64_t min() const { return m_total_count == 0 ? 0 : m_min; }
+	int64_t max() const { return m_max; }
+	double mean() const { return m_total_count == 0 ? 0 : m_sum / m_total_count; }
+
+private:
+	int32_t bucketIndex(int64_t value) const {
+		int32_t pow2_ceiling = 64 - std::countl_zero(static_cast<uint64_t>(value | m_sub_bucket_mask));
+		return pow2_ceiling - m_unit_magnitude - (m_sub_bucket_half_count_magnitude + 1);
+	}
+
+	int32_t subBucketIndex(int64_t value, int32_t bucket_index) const {
+		return static_cast<int32_t>(value >> (bucket_index + m_unit_magnitude));
+	}
+
+	std::size_t countsIndexFor(int64_t value) const {
+		auto bucket_index = bucketIndex(value);
+		auto sub_bucket_index = subBucketIndex(value, bucket_index);
+		return ((bucket_index + 1) << m_sub_bucket_half_count_magnitude) + (sub_bucket_index - m_sub_bucket_half_count);
+	}
+
+	int64_t valueFromIndex(int32_t index) const {
+		int32_t bucket_index = (index >> m_sub_bucket_half_count_magnitude) - 1;
+		int32_t sub_bucket_index = (index & (m_sub_bucket_half_count - 1)) + m_sub_bucket_half_count;
+		if (bucket_index < 0) {
+			sub_bucket_index -= m_sub_bucket_half_count;
+			bucket_index = 0;
+		}
+		return static_cast<int64_t>(sub_bucket_index) << (bucket_index + m_unit_magnitude);
+	}
+
+	int64_t highestEquivalentValue(int64_t value) const {
+		auto bucket_index = bucketIndex(value);
+		auto sub_bucket_index = subBucketIndex(value, bucket_index);
+		auto adjusted_bucket = sub_bucket_index >= m_sub_bucket_count ? bucket_index + 1 : bucket_index;
+		auto lowest_equivalent_value = static_cast<int64_t>(sub_bucket_index) << (bucket_index + m_unit_magnitude);
+		return lowest_equivalent_value + (int64_t{1} << (m_unit_magnitude + adjusted_bucket)) - 1;
+	}
+
+	int64_t m_lowest_trackable_value;
+	int64_t m_highest_trackable_value;
+	int32_t m_unit_magnitude;
+	int32_t m_sub_bucket_count_magnitude;
+	int32_t m_sub_bucket_half_count_magnitude;
+	int64_t m_sub_bucket_count;
+	int64_t m_sub_bucket_half_count;
+	int64_t m_sub_bucket_mask;
+	std::vector<int64_t> m_counts;
+	int64_t m_total_count{0};
+	int64_t m_min{INT64_MAX};
+	int64_t m_max{0};
+	double m_sum{0};
+};
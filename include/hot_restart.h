@@ -0,0 +1,122 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Hot restart: the running server keeps a unix socket open, the next generation connects to it and receives the
+// listening socket, then optionally the idle client connections, as SCM_RIGHTS ancillary data. The kernel socket
+// never closes, so nothing queued in the accept backlog or in a connection's receive buffer is lost. The new
+// generation accepts as soon as it holds the listener, the connections arrive once the old sessions parked them.
+//
+//   new -> old  Handoff
+//   old -> new  Listener     (1 fd)
+//   old -> new  Connections  (up to kMaxHandoffFds fds, repeated)
+//   old -> new  End
+enum class HandoffMessage : char {
+	Handoff = 'H',
+	Listener = 'L',
+	Connections = 'C',
+	End = 'E',
+};
+
+// SCM_MAX_FD on linux
+constexpr size_t kMaxHandoffFds = 253;
+
+inline bool send_fds(int sock, HandoffMessage type, const std::vector<int>& fds) {
+	if (fds.size() > kMaxHandoffFds)
+		return false;
+	char data = static_cast<char>(type);
+	iovec iov{&data, 1};
+	msghdr msg{};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	std::vector<char> control(CMSG_SPACE(sizeof(int) * kMaxHandoffFds));
+	if (!fds.empty()) {
+		msg.msg_control = control.data();
+		msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+		auto cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+		std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+	}
+	ssize_t ret;
+	do {
+		ret = ::sendmsg(sock, &msg, MSG_NOSIGNAL);
+	} while (ret < 0 && errno == EINTR);
+	return ret == 1;
+}
+
+inline std::optional<std::pair<HandoffMessage, std::vector<int>>> recv_fds(int sock) {
+	char data = 0;
+	iovec iov{&data, 1};
+	std::vector<char> control(CMSG_SPACE(sizeof(int) * kMaxHandoffFds));
+	msghdr msg{};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.data();
+	msg.msg_controllen = control.size();
+	ssize_t ret;
+	do {
+		ret = ::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+	} while (ret < 0 && errno == EINTR);
+	if (ret != 1)
+		return std::nullopt;
+	std::vector<int> fds;
+	for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+		auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		auto begin = fds.size();
+		fds.resize(begin + count);
+		std::memcpy(fds.data() + begin, CMSG_DATA(cmsg), sizeof(int) * count);
+	}
+	return std::make_pair(static_cast<HandoffMessage>(data), std::move(fds));
+}
+
+// How long the new generation waits for the listening socket. The connections can take up to the old generation's
+// drain_timeout on top, its busy sessions finish their request first.
+constexpr std::chrono::milliseconds kHandoffTimeout{std::chrono::seconds(5)};
+
+inline bool set_recv_timeout(int sock, std::chrono::milliseconds timeout) {
+	timeval tv{static_cast<time_t>(timeout.count() / 1000), static_cast<suseconds_t>(timeout.count() % 1000 * 1000)};
+	return ::setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0;
+}
+
+// Blocking client side used by the new generation at startup, bounded by timeout. Returns the inherited listening
+// socket, which can accept right away, and the control socket the connections follow on, Connections messages up
+// to End. nullopt when no previous generation is listening on path (cold start) or it does not answer in time.
+inline std::optional<std::pair<int, int>> take_over(const std::string& path, std::chrono::milliseconds timeout = kHandoffTimeout) {
+	sockaddr_un addr{};
+	if (path.size() >= sizeof(addr.sun_path))
+		return std::nullopt;
+	addr.sun_family = AF_UNIX;
+	std::memcpy(addr.sun_path, path.c_str(), path.size());
+	int sock = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (sock < 0)
+		return std::nullopt;
+	if (!set_recv_timeout(sock, timeout) || ::connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+		!send_fds(sock, HandoffMessage::Handoff, {})) {
+		::close(sock);
+		return std::nullopt;
+	}
+	auto message = recv_fds(sock);
+	if (!message || message.value().first != HandoffMessage::Listener || message.value().second.size() != 1) {
+		if (message) {
+			for (auto fd : message.value().second)
+				::close(fd);
+		}
+		::close(sock);
+		return std::nullopt;
+	}
+	return std::make_pair(message.value().second[0], sock);
+}
@@ -1,14 +1,26 @@
 #pragma once
 
+#include <pthread.h>
+
+#include <cstdint>
+#include <cstring>
 #include <list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include <spdlog/spdlog.h>
 #include <boost/asio.hpp>
 
 class IoContextPool final {
 public:
 	explicit IoContextPool(std::size_t);
 
-	void start();
+	// threads are pinned round-robin to the given cpus, an empty list leaves scheduling to the kernel; a cpu outside
+	// 0..CPU_SETSIZE throws before any thread starts, one the kernel refuses leaves its thread unpinned with an error
+	void start(const std::vector<int32_t>& cpu_affinity = {});
 	void stop();
 
 	boost::asio::io_context& getIoContext();
@@ -31,9 +43,22 @@ inline IoContextPool::IoContextPool(std::size_t pool_size)
 	}
 }
 
-inline void IoContextPool::start() {
+inline void IoContextPool::start(const std::vector<int32_t>& cpu_affinity) {
+	for (auto cpu : cpu_affinity) {
+		if (cpu < 0 || cpu >= CPU_SETSIZE)
+			throw std::invalid_argument("IoContextPool cpu_affinity out of range: " + std::to_string(cpu));
+	}
 	for (auto& context : m_io_contexts)
-		m_threads.emplace_back(std::thread([&] { context->run(); }));
+		m_threads.emplace_back(std::thread([context] { context->run(); }));
+	for (std::size_t i = 0; i < m_threads.size() && !cpu_affinity.empty(); ++i) {
+		auto cpu = cpu_affinity[i % cpu_affinity.size()];
+		cpu_set_t cpu_set;
+		CPU_ZERO(&cpu_set);
+		CPU_SET(cpu, &cpu_set);
+		// returns the error number instead of setting errno
+		if (auto error = pthread_setaffinity_np(m_threads[i].native_handle(), sizeof(cpu_set_t), &cpu_set); error != 0)
+			spdlog::error("IoContextPool: pinning thread {} to cpu {} failed: {}", i, cpu, strerror(error));
+	}
 }
 
 inline void IoContextPool::stop() {
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+struct LoadBalancerConfig {
+	// time constant of the latency moving average, older samples weigh e^(-age/decay_time)
+	std::chrono::milliseconds decay_time{std::chrono::seconds(10)};
+	// latency assumed for backends without samples while no backend has any
+	std::chrono::microseconds initial_latency{std::chrono::milliseconds(1)};
+	// consecutive failures before a backend is ejected
+	uint32_t failure_threshold{5};
+	// a backend whose average latency is this many times the median of the others is ejected
+	double latency_outlier_factor{5.0};
+	// samples a backend needs before it can be ejected for latency
+	uint32_t min_samples{20};
+	// doubled on every ejection in a row, up to max_ejection_time
+	std::chrono::milliseconds ejection_time{std::chrono::seconds(5)};
+	std::chrono::milliseconds max_ejection_time{std::chrono::seconds(60)};
+	// at most this share of the backends is ejected at once, the rest keep serving even if unhealthy
+	double max_ejected_ratio{0.5};
+};
+
+// Client side balancer over any movable backend handle: a host:port for the asio_util.hpp client path, a
+// std::shared_ptr<grpc::Channel> for gRPC (GreeterClient is not movable), a drogon::HttpClientPtr for drogon. It
+// never touches the backends itself, callers pick() one, run the request on it and report the outcome through the
+// Lease.
+//
+// Selection is power of two choices: two random healthy backends are compared on (in flight + 1) * average latency
+// and the cheaper one wins. That follows the least loaded backend without the herding onto a single "best" one that
+// a global minimum causes when many clients share the same view. Backends failing in a row, or much slower than
+// the rest, are ejected for a while and come back on their own.
+//
+// Thread safe, the bookkeeping is a few arithmetic operations under one mutex.
+template <typename Backend>
+class LoadBalancer final {
+public:
+	// Outcome of one request, reported as a failure if neither success() nor failure() was called, so a request
+	// abandoned by an exception still releases its in-flight slot.
+	class Lease {
+	public:
+		Lease(LoadBalancer& balancer, std::size_t index)
+			: m_balancer(&balancer)
+			, m_backend(&balancer.m_backends[index].backend)
+			, m_index(index)
+			, m_start(std::chrono::steady_clock::now()) {
+		}
+		Lease(Lease&& other) noexcept
+			: m_balancer(std::exchange(other.m_balancer, nullptr))
+			, m_backend(std::exchange(other.m_backend, nullptr))
+			, m_index(other.m_index)
+			, m_start(other.m_start) {
+		}
+		Lease(const Lease&) = delete;
+		Lease& operator=(const Lease&) = delete;
+		~Lease() { failure(); }
+
+		// still valid once the outcome is reported, the backends live as long as the balancer
+		Backend& backend() const {
+			if (!m_backend)
+				throw std::logic_error("LoadBalancer::Lease used after move");
+			return *m_backend;
+		}
+		Backend* operator->() const { return &backend(); }
+		std::size_t index() const { return m_index; }
+
+		void success() { report(true); }
+		void failure() { report(false); }
+
+	private:
+		void report(bool ok) {
+			if (m_balancer)
+				std::exchange(m_balancer, nullptr)->report(m_index, ok, std::chrono::steady_clock::now() - m_start);
+		}
+
+		// cleared once the outcome is reported
+		LoadBalancer* m_balancer;
+		Backend* m_backend;
+		std::size_t m_index;
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+	explicit LoadBalancer(std::vector<Backend> backends, LoadBalancerConfig config = {})
+		: m_config(config) {
+		if (backends.empty())
+			throw std::invalid_argument("LoadBalancer without backends");
+		for (auto& backend : backends)
+			m_backends.emplace_back(std::move(backend));
+	}
+
+	LoadBalancer(const LoadBalancer&) = delete;
+	LoadBalancer& operator=(const LoadBalancer&) = delete;
+
+	Lease pick() {
+		std::lock_guard<std::mutex> lk(m_mutex);
+		auto now = std::chrono::steady_clock::now();
+		thread_local std::mt19937_64 rng{std::random_device{}()};
+		m_candidates.clear();
+		for (std::size_t i = 0; i < m_backends.size(); ++i) {
+			if (m_backends[i].ejected_until <= now)
+				m_candidates.emplace_back(i);
+		}
+		// everything ejected: better to try an unhealthy backend than to fail without trying
+		if (m_candidates.empty()) {
+			for (std::size_t i = 0; i < m_backends.size(); ++i)
+				m_candidates.emplace_back(i);
+		}
+		// a backend without samples is rated as the fastest known one, so new and returning backends get probed
+		auto unsampled_latency = static_cast<double>(m_config.initial_latency.count());
+		bool any_sampled = false;
+		for (auto& state : m_backends) {
+			if (state.samples > 0) {
+				unsampled_latency = any_sampled ? std::min(unsampled_latency, state.latency) : state.latency;
+				any_sampled = true;
+			}
+		}
+		auto index = m_candidates[0];
+		if (m_candidates.size() > 1) {
+			std::uniform_int_distribution<std::size_t> dist{0, m_candidates.size() - 1};
+			auto first = dist(rng);
+			auto second = dist(rng);
+			while (second == first)
+				second = dist(rng);
+			index = cost(m_candidates[first], unsampled_latency) <= cost(m_candidates[second], unsampled_latency) ? m_candidates[first] : m_candidates[second];
+		}
+		m_backends[index].in_flight++;
+		return Lease{*this, index};
+	}
+
+	std::size_t size() const { return m_backends.size(); }
+	const Backend& backend(std::size_t index) const { return m_backends[index].backend; }
+
+	bool ejected(std::size_t index) const {
+		std::lock_guard<std::mutex> lk(m_mutex);
+		return m_backends[index].ejected_until > std::chrono::steady_clock::now();
+	}
+
+	// average latency in microseconds
+	double latency(std::size_t index) const {
+		std::lock_guard<std::mutex> lk(m_mutex);
+		return m_backends[index].latency;
+	}
+
+private:
+	struct State {
+		State(Backend backend)
+			: backend(std::move(backend)) {
+		}
+
+		Backend backend;
+		int64_t in_flight{0};
+		// microseconds, meaningful once samples > 0
+		double latency{0};
+		std::chrono::steady_clock::time_point last_sample{};
+		uint64_t samples{0};
+		uint32_t consecutive_failures{0};
+		uint32_t consecutive_ejections{0};
+		std::chrono::steady_clock::time_point ejected_until{};
+	};
+
+	double cost(std::size_t index, double unsampled_latency) const {
+		auto& state = m_backends[index];
+		return (state.in_flight + 1) * (state.samples > 0 ? state.latency : unsampled_latency);
+	}
+
+	void report(std::size_t index, bool ok, std::chrono::steady_clock::duration elapsed) {
+		std::lock_guard<std::mutex> lk(m_mutex);
+		auto now = std::chrono::steady_clock::now();
+		auto& state = m_backends[index];
+		state.in_flight--;
+		auto sample = std::chrono::duration<double, std::micro>(elapsed).count();
+		// a failure counts as at least as slow as the current average, fast errors must not attract traffic
+		if (!ok && state.samples > 0)
+			sample = std::max(sample, state.latency);
+		if (state.samples == 0) {
+			state.latency = sample;
+		}
+		else {
+			auto age = std::chrono::duration<double, std::milli>(now - state.last_sample).count();
+			auto weight = std::exp(-age / m_config.decay_time.count());
+			state.latency = state.latency * weight + sample * (1 - weight);
+		}
+		state.last_sample = now;
+		state.samples++;
+		if (ok)
+			state.consecutive_failures = 0;
+		else
+			state.consecutive_failures++;
+		if (state.ejected_until > now)
+			return;
+		if (state.consecutive_failures >= m_config.failure_threshold || slowOutlier(index))
+			eject(index, now);
+		else if (ok)
+			state.consecutive_ejections = 0;
+	}
+
+	bool slowOutlier(std::size_t index) {
+		if (m_backends.size() < 2 || m_backends[index].samples < m_config.min_samples)
+			return false;
+		m_latencies.clear();
+		for (std::size_t i = 0; i < m_backends.size(); ++i) {
+			if (i != index && m_backends[i].samples >= m_config.min_samples)
+				m_latencies.emplace_back(m_backends[i].latency);
+		}
+		if (m_latencies.empty())
+			return false;
+		auto middle = m_latencies.begin() + m_latencies.size() / 2;
+		std::nth_element(m_latencies.begin(), middle, m_latencies.end());
+		return m_backends[index].latency > *middle * m_config.latency_outlier_factor;
+	}
+
+	void eject(std::size_t index, std::chrono::steady_clock::time_point now) {
+		auto ejected = std::count_if(m_backends.begin(), m_backends.end(), [&](auto& state) { return state.ejected_until > now; });
+		if (ejected + 1 > static_cast<int64_t>(m_backends.size() * m_config.max_ejected_ratio))
+			return;
+		auto& state = m_backends[index];
+		auto duration = std::min(m_config.ejection_time * (int64_t{1} << std::min<uint32_t>(state.consecutive_ejections, 16)), m_config.max_ejection_time);
+		state.ejected_until = now + duration;
+		state.consecutive_ejections++;
+		state.consecutive_failures = 0;
+		// back with a clean slate, the old average would eject it again on the first sample
+		state.samples = 0;
+	}
+
+	LoadBalancerConfig m_config;
+	mutable std::mutex m_mutex;
+	std::vector<State> m_backends;
+	std::vector<std::size_t> m_candidates;
+	std::vector<double> m_latencies;
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <boost/endian/conversion.hpp>
+
+#include <folly/experimental/coro/Collect.h>
+
+#include <asio_util.hpp>
+
+// Many requests in flight on one connection: every frame carries a request id and replies may come back in any
+// order, so a slow request does not hold up the ones behind it and the connection is bounded by bandwidth rather
+// than by one round trip per request.
+//
+//   frame: u32 payload length (big endian) | u64 request id (big endian) | payload
+//
+// An echo server is a valid peer, it returns each frame with its id unchanged.
+//
+// Like the socket, a channel must only be used from its io_context's thread. run() drives the connection and has
+// to be running for call() to complete; it returns after close() or a connection error, and the channel must
+// outlive it.
+class MultiplexChannel final {
+public:
+	static constexpr std::size_t kHeaderSize = sizeof(uint32_t) + sizeof(uint64_t);
+	static constexpr std::size_t kMaxFrameSize = 64 * 1024 * 1024;
+
+	explicit MultiplexChannel(boost::asio::ip::tcp::socket socket)
+		: m_socket(std::move(socket))
+		, m_write_signal(m_socket.get_executor()) {
+		m_write_signal.expires_at(boost::asio::steady_timer::time_point::max());
+		m_read_buffer.resize(64 * 1024);
+	}
+
+	MultiplexChannel(const MultiplexChannel&) = delete;
+	MultiplexChannel& operator=(const MultiplexChannel&) = delete;
+
+	folly::coro::Task<void> run() {
+		co_await folly::coro::collectAll(readLoop(), writeLoop());
+		co_return;
+	}
+
+	// fails every outstanding call with operation_aborted
+	void close() {
+		fail(boost::asio::error::operation_aborted);
+	}
+
+	folly::coro::Task<std::pair<boost::system::error_code, std::string>> call(std::string_view payload) {
+		if (m_ec)
+			co_return std::make_pair(m_ec, std::string{});
+		if (payload.size() > kMaxFrameSize)
+			co_return std::make_pair(boost::system::error_code{boost::asio::error::message_size}, std::string{});
+		auto id = m_next_id++;
+		Pending pending;
+		m_pending.emplace(id, &pending);
+		appendFrame(id, payload);
+		// frames of every call made before the writer runs again go out in one write
+		m_write_signal.cancel();
+		co_await ResponseAwaiter{pending};
+		co_return std::make_pair(pending.ec, std::move(pending.payload));
+	}
+
+	std::size_t inFlight() const { return m_pending.size(); }
+
+private:
+	struct Pending {
+		std::coroutine_handle<> handle;
+		bool done{false};
+		boost::system::error_code ec;
+		std::string payload;
+	};
+
+	class ResponseAwaiter {
+	public:
+		ResponseAwaiter(Pending& pending)
+			: m_pending(pending) {
+		}
+
+		bool await_ready() const noexcept { return m_pending.done; }
+		void await_suspend(std::coroutine_handle<> handle) { m_pending.handle = handle; }
+		void await_resume() noexcept {}
+
+	private:
+		Pending& m_pending;
+	};
+
+	void appendFrame(uint64_t id, std::string_view payload) {
+		auto offset = m_write_buffer.size();
+		m_write_buffer.resize(offset + kHeaderSize + payload.size());
+		auto length = boost::endian::native_to_big(static_cast<uint32_t>(payload.size()));
+		id = boost::endian::native_to_big(id);
+		std::memcpy(m_write_buffer.data() + offset, &length, sizeof(length));
+		std::memcpy(m_write_buffer.data() + offset + sizeof(length), &id, sizeof(id));
+		std::memcpy(m_write_buffer.data() + offset + kHeaderSize, payload.data(), payload.size());
+	}
+
+	void complete(Pending& pending, boost::system::error_code ec, std::string payload) {
+		pending.done = true;
+		pending.ec = ec;
+		pending.payload = std::move(payload);
+		// resume from the io_context rather than from inside the read loop
+		if (pending.handle)
+			boost::asio::post(m_socket.get_executor(), [handle = pending.handle] { handle.resume(); });
+	}
+
+	void fail(boost::system::error_code ec) {
+		if (m_ec)
+			return;
+		m_ec = ec;
+		boost::system::error_code ignore_ec;
+		m_socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignore_ec);
+		m_socket.close(ignore_ec);
+		m_write_signal.cancel();
+		for (auto& [id, pending] : m_pending)
+			complete(*pending, ec, {});
+		m_pending.clear();
+	}
+
+	folly::coro::Task<void> writeLoop() {
+		while (!m_ec) {
+			if (m_write_buffer.empty()) {
+				m_write_signal.expires_at(boost::asio::steady_timer::time_point::max());
+				co_await timeout(m_write_signal);
+				continue;
+			}
+			m_sending.swap(m_write_buffer);
+			auto [ec, length] = co_await async_write(m_socket, boost::asio::buffer(m_sending));
+			m_sending.clear();
+			if (ec)
+				fail(ec);
+		}
+		co_return;
+	}
+
+	folly::coro::Task<void> readLoop() {
+		std::size_t size = 0;
+		while (!m_ec) {
+			if (size == m_read_buffer.size())
+				m_read_buffer.resize(m_read_buffer.size() * 2);
+			auto [ec, length] = co_await async_read_some(m_socket, boost::asio::buffer(m_read_buffer.data() + size, m_read_buffer.size() - size));
+			if (ec) {
+				fail(ec);
+				break;
+			}
+			size += length;
+			std::size_t offset = 0;
+			while (size - offset >= kHeaderSize) {
+				uint32_t payload_size;
+				uint64_t id;
+				std::memcpy(&payload_size, m_read_buffer.data() + offset, sizeof(payload_size));
+				std::memcpy(&id, m_read_buffer.data() + offset + sizeof(payload_size), sizeof(id));
+				payload_size = boost::endian::big_to_native(payload_size);
+				id = boost::endian::big_to_native(id);
+				if (payload_size > kMaxFrameSize) {
+					fail(boost::asio::error::message_size);
+					co_return;
+				}
+				if (size - offset < kHeaderSize + payload_size) {
+					if (m_read_buffer.size() < kHeaderSize + payload_size)
+						m_read_buffer.resize(kHeaderSize + payload_size);
+					break;
+				}
+				// a reply to a call nobody waits for any more is dropped
+				if (auto it = m_pending.find(id); it != m_pending.end()) {
+					complete(*it->second, {}, std::string(m_read_buffer.data() + offset + kHeaderSize, payload_size));
+					m_pending.erase(it);
+				}
+				offset += kHeaderSize + payload_size;
+			}
+			std::memmove(m_read_buffer.data(), m_read_buffer.data() + offset, size - offset);
+			size -= offset;
+		}
+		co_return;
+	}
+
+	boost::asio::ip::tcp::socket m_socket;
+	// cancelled to wake the writer, which otherwise waits forever
+	boost::asio::steady_timer m_write_signal;
+	std::string m_write_buffer;
+	std::string m_sending;
+	std::vector<char> m_read_buffer;
+	uint64_t m_next_id{0};
+	std::unordered_map<uint64_t, Pending*> m_pending;
+	boost::system::error_code m_ec;
+};
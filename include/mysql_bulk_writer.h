@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include <folly/experimental/coro/Collect.h>
+
+#include <mysql_pool.h>
+
+// One column of a row handed to MysqlBulkWriter. Unlike boost::mysql::value it owns its string, the row is kept
+// until its batch is written.
+using MysqlBulkField = std::variant<std::nullptr_t, int64_t, uint64_t, double, std::string>;
+using MysqlBulkRow = std::vector<MysqlBulkField>;
+
+struct MysqlBulkWriterConfig {
+	// connections inserting in parallel, each one is acquired from the sub pool for the whole run
+	std::size_t writers{1};
+	std::size_t initial_batch_rows{64};
+	std::size_t max_batch_rows{8192};
+	// a batch faster than half of this doubles the batch size, a slower one halves it
+	std::chrono::milliseconds target_latency{50};
+	// push() waits while this many rows are queued
+	std::size_t max_queued_rows{65536};
+	// 0 asks the server for max_allowed_packet
+	std::size_t max_packet_bytes{0};
+};
+
+// Bulk INSERT fed through an in-process channel: producers co_await push() one row at a time, writers drain the
+// queue in multi-row INSERT ... VALUES (?, ...), (?, ...) statements executed through the connection's statement
+// cache, so a batch is one round trip and one server side parse per batch size.
+//
+// Batch sizes are powers of two, which bounds the distinct statements per connection to log2(max_batch_rows). A
+// batch is also held under max_allowed_packet and the 65535 placeholders of a statement, and adapts between 1 and
+// max_batch_rows to keep its latency around target_latency.
+//
+// A failed batch fails the writer: push() and run() return its error and the rows still queued are dropped. Like
+// its sub pool, a writer must only be used from the sub pool's io_context.
+//
+//   MysqlBulkWriter writer(pool.subPool(io_context), "t", {"id", "name"});
+//   co_await folly::coro::collectAll(writer.run(), [&]() -> folly::coro::Task<void> {
+//       co_await writer.push({int64_t{1}, std::string{"one"}});
+//       writer.close();
+//   }());
+class MysqlBulkWriter final {
+public:
+	MysqlBulkWriter(MysqlSubPool& pool, std::string table, std::vector<std::string> columns, MysqlBulkWriterConfig config = {})
+		: m_pool(pool)
+		, m_table(std::move(table))
+		, m_columns(std::move(columns))
+		, m_config(config)
+		, m_rows_signal(pool.ioContext())
+		, m_space_signal(pool.ioContext()) {
+		if (m_columns.empty() || m_config.writers == 0 || m_config.initial_batch_rows == 0 || m_config.max_batch_rows == 0)
+			throw std::invalid_argument("MysqlBulkWriter needs columns, writers, initial_batch_rows and max_batch_rows");
+		m_rows_signal.expires_at(boost::asio::steady_timer::time_point::max());
+		m_space_signal.expires_at(boost::asio::steady_timer::time_point::max());
+		m_batch_rows = std::bit_floor(std::min(m_config.initial_batch_rows, maxBatchRows()));
+	}
+
+	MysqlBulkWriter(const MysqlBulkWriter&) = delete;
+	MysqlBulkWriter& operator=(const MysqlBulkWriter&) = delete;
+
+	// Returns once close() was called and every queued row is written, or on the first error.
+	folly::coro::Task<boost::system::error_code> run() {
+		if (m_config.max_packet_bytes == 0) {
+			auto ec = co_await queryMaxPacket();
+			if (ec) {
+				fail(ec);
+				co_return ec;
+			}
+		}
+		else {
+			m_max_packet_bytes = m_config.max_packet_bytes;
+		}
+		std::vector<folly::coro::Task<void>> writers;
+		for (std::size_t i = 0; i < m_config.writers; ++i)
+			writers.emplace_back(writeLoop());
+		co_await folly::coro::collectAllRange(std::move(writers));
+		co_return m_ec;
+	}
+
+	folly::coro::Task<boost::system::error_code> push(MysqlBulkRow row) {
+		if (row.size() != m_columns.size())
+			co_return boost::system::error_code{boost::asio::error::invalid_argument};
+		while (!m_ec && !m_closed && m_rows.size() >= m_config.max_queued_rows)
+			co_await timeout(m_space_signal);
+		if (m_ec)
+			co_return m_ec;
+		if (m_closed)
+			co_return boost::system::error_code{boost::asio::error::operation_aborted};
+		m_rows.emplace_back(std::move(row));
+		if (m_waiting_writers > 0)
+			m_rows_signal.cancel();
+		co_return boost::system::error_code{};
+	}
+
+	// no more rows, run() returns once the queue is written
+	void close() {
+		m_closed = true;
+		m_rows_signal.cancel();
+		m_space_signal.cancel();
+	}
+
+	uint64_t rowsWritten() const { return m_rows_written; }
+	uint64_t batchCount() const { return m_batches; }
+	std::size_t batchRows() const { return m_batch_rows; }
+
+private:
+	folly::coro::Task<boost::system::error_code> queryMaxPacket() {
+		auto [ec, conn] = co_await m_pool.acquire();
+		if (ec)
+			co_return ec;
+		auto [query_ec, ei, result] = co_await async_query(*conn, "SELECT @@max_allowed_packet");
+		if (query_ec) {
+			conn.discard();
+			co_return query_ec;
+		}
+		auto [read_ec, read_ei, rows] = co_await read_all(result);
+		if (read_ec) {
+			conn.discard();
+			co_return read_ec;
+		}
+		std::optional<uint64_t> max_packet;
+		if (!rows.empty() && !rows[0].values().empty()) {
+			auto& field = rows[0].values()[0];
+			max_packet = field.get_std_optional<uint64_t>();
+			if (auto signed_max_packet = field.get_std_optional<int64_t>(); !max_packet && signed_max_packet && *signed_max_packet > 0)
+				max_packet = static_cast<uint64_t>(*signed_max_packet);
+		}
+		if (!max_packet || *max_packet == 0) {
+			spdlog::error("bulk insert into {}: @@max_allowed_packet is not a positive integer", m_table);
+			co_return boost::system::error_code{boost::asio::error::invalid_argument};
+		}
+		m_max_packet_bytes = static_cast<std::size_t>(*max_packet);
+		co_return query_ec;
+	}
+
+	folly::coro::Task<void> writeLoop() {
+		auto [ec, conn] = co_await m_pool.acquire();
+		if (ec) {
+			fail(ec);
+			co_return;
+		}
+		std::vector<MysqlBulkRow> batch;
+		while (true) {
+			while (!m_ec && !m_closed && m_rows.empty()) {
+				m_waiting_writers++;
+				co_await timeout(m_rows_signal);
+				m_waiting_writers--;
+			}
+			if (m_ec || m_rows.empty())
+				break;
+			takeBatch(batch);
+			m_space_signal.cancel();
+			auto begin = std::chrono::steady_clock::now();
+			std::vector<boost::mysql::value> params;
+			params.reserve(batch.size() * m_columns.size());
+			for (auto& row : batch) {
+				for (auto& field : row)
+					params.emplace_back(std::visit([](auto& v) { return toValue(v); }, field));
+			}
+			auto [execute_ec, ei, result] = co_await async_execute(conn, insertSql(batch.size()), std::move(params));
+			if (execute_ec) {
+				spdlog::error("bulk insert of {} rows into {}: {}-{}", batch.size(), m_table, execute_ec.message(), ei.message());
+				conn.discard();
+				fail(execute_ec);
+				break;
+			}
+			adapt(batch.size(), std::chrono::steady_clock::now() - begin);
+			m_rows_written += batch.size();
+			m_batches++;
+		}
+		co_return;
+	}
+
+	// the largest power of two of queued rows that fits the batch size, the packet and the placeholder limit
+	void takeBatch(std::vector<MysqlBulkRow>& batch) {
+		batch.clear();
+		auto budget = m_max_packet_bytes - std::min(m_max_packet_bytes, insertSql(1).size() + 1024);
+		std::size_t count = 0;
+		std::size_t bytes = 0;
+		auto limit = std::min(m_batch_rows, m_rows.size());
+		while (count < limit) {
+			auto row_bytes = rowBytes(m_rows[count]);
+			// the NULL bitmap grows with the placeholders of the whole statement
+			auto bitmap_bytes = ((count + 1) * m_columns.size() + 7) / 8;
+			// a single row always goes, the server rejects it if it really is too large
+			if (count > 0 && bytes + row_bytes + bitmap_bytes > budget)
+				break;
+			bytes += row_bytes;
+			count++;
+		}
+		count = std::bit_floor(count);
+		for (std::size_t i = 0; i < count; ++i) {
+			batch.emplace_back(std::move(m_rows.front()));
+			m_rows.pop_front();
+		}
+	}
+
+	void adapt(std::size_t rows, std::chrono::steady_clock::duration latency) {
+		if (latency > m_config.target_latency)
+			m_batch_rows = std::max<std::size_t>(1, m_batch_rows / 2);
+		else if (rows == m_batch_rows && latency < m_config.target_latency / 2)
+			m_batch_rows = std::min(m_batch_rows * 2, maxBatchRows());
+	}
+
+	std::size_t maxBatchRows() const { return std::bit_floor(std::min(m_config.max_batch_rows, 65535 / m_columns.size())); }
+
+	// COM_STMT_EXECUTE size of a row: 2 type bytes per parameter, then length prefixed strings and 8 bytes for
+	// anything else; the NULL bitmap is counted per batch
+	static std::size_t rowBytes(const MysqlBulkRow& row) {
+		std::size_t bytes = 0;
+		for (auto& field : row)
+			bytes += 2 + (std::holds_alternative<std::string>(field) ? std::get<std::string>(field).size() + 9 : 8);
+		return bytes;
+	}
+
+	std::string insertSql(std::size_t rows) const {
+		std::string sql = "INSERT INTO " + m_table + " (";
+		std::string placeholders = "(";
+		for (std::size_t i = 0; i < m_columns.size(); ++i) {
+			sql += (i == 0 ? "" : ", ") + m_columns[i];
+			placeholders += i == 0 ? "?" : ", ?";
+		}
+		placeholders += ")";
+		sql += ") VALUES ";
+		sql.reserve(sql.size() + rows * (placeholders.size() + 2));
+		for (std::size_t i = 0; i < rows; ++i) {
+			if (i > 0)
+				sql += ", ";
+			sql += placeholders;
+		}
+		return sql;
+	}
+
+	static boost::mysql::value toValue(const std::string& v) { return boost::mysql::value{std::string_view{v}}; }
+	template <typename T>
+	static boost::mysql::value toValue(const T& v) { return boost::mysql::value{v}; }
+
+	void fail(boost::system::error_code ec) {
+		if (!m_ec)
+			m_ec = ec;
+		m_rows.clear();
+		m_rows_signal.cancel();
+		m_space_signal.cancel();
+	}
+
+	MysqlSubPool& m_pool;
+	std::string m_table;
+	std::vector<std::string> m_columns;
+	MysqlBulkWriterConfig m_config;
+	std::deque<MysqlBulkRow> m_rows;
+	// cancelled to wake the writers waiting for rows and the producers waiting for space, never expires otherwise
+	boost::asio::steady_timer m_rows_signal;
+	boost::asio::steady_timer m_space_signal;
+	std::size_t m_waiting_writers{0};
+	std::size_t m_batch_rows{1};
+	std::size_t m_max_packet_bytes{0};
+	bool m_closed{false};
+	boost::system::error_code m_ec;
+	uint64_t m_rows_written{0};
+	uint64_t m_batches{0};
+};
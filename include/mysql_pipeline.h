@@ -0,0 +1,324 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <folly/experimental/coro/Collect.h>
+
+#include <asio_util.hpp>
+#include <mysql_util.hpp>
+
+// Outcome of one statement of a pipeline. A failed statement does not stop the ones after it, the server runs every
+// command it received.
+struct MysqlPipelineResult {
+	// server error number, 0 when the statement succeeded
+	uint16_t error_code{0};
+	std::string sql_state;
+	std::string error_message;
+	uint64_t affected_rows{0};
+	uint64_t last_insert_id{0};
+	uint16_t warnings{0};
+	std::vector<std::string> columns;
+	// text protocol values, std::nullopt for NULL
+	std::vector<std::vector<std::optional<std::string>>> rows;
+
+	bool ok() const { return error_code == 0; }
+};
+
+namespace mysql_pipeline_detail {
+
+constexpr std::size_t kMaxPayload = 0xffffff;
+constexpr uint8_t kComQuery = 0x03;
+constexpr uint8_t kOkHeader = 0x00;
+constexpr uint8_t kEofHeader = 0xfe;
+constexpr uint8_t kErrHeader = 0xff;
+constexpr uint8_t kNullValue = 0xfb;
+constexpr uint16_t kServerMoreResultsExist = 0x0008;
+
+// The protocol's length encoded integers and strings, out of a packet payload. Reading past the end fails the
+// reader instead of throwing, callers check ok() once per packet.
+class PayloadReader {
+public:
+	explicit PayloadReader(std::string_view payload)
+		: m_payload(payload) {
+	}
+
+	bool ok() const { return m_ok; }
+	bool empty() const { return m_pos >= m_payload.size(); }
+
+	uint64_t fixed(std::size_t bytes) {
+		if (!need(bytes))
+			return 0;
+		uint64_t value = 0;
+		for (std::size_t i = 0; i < bytes; ++i)
+			value |= static_cast<uint64_t>(static_cast<uint8_t>(m_payload[m_pos + i])) << (8 * i);
+		m_pos += bytes;
+		return value;
+	}
+
+	uint64_t lenenc() {
+		auto first = fixed(1);
+		if (first < 0xfb)
+			return first;
+		if (first == 0xfc)
+			return fixed(2);
+		if (first == 0xfd)
+			return fixed(3);
+		if (first == 0xfe)
+			return fixed(8);
+		m_ok = false;
+		return 0;
+	}
+
+	std::string_view bytes(std::size_t size) {
+		if (!need(size))
+			return {};
+		auto value = m_payload.substr(m_pos, size);
+		m_pos += size;
+		return value;
+	}
+
+	std::string_view lenencString() { return bytes(lenenc()); }
+
+	// a row value: NULL or a length encoded string
+	std::optional<std::string> value() {
+		if (need(1) && static_cast<uint8_t>(m_payload[m_pos]) == kNullValue) {
+			m_pos++;
+			return std::nullopt;
+		}
+		return std::string{lenencString()};
+	}
+
+	std::string_view rest() { return bytes(m_payload.size() - std::min(m_pos, m_payload.size())); }
+
+private:
+	bool need(std::size_t bytes) {
+		if (m_ok && m_payload.size() - std::min(m_pos, m_payload.size()) >= bytes)
+			return true;
+		m_ok = false;
+		return false;
+	}
+
+	std::string_view m_payload;
+	std::size_t m_pos{0};
+	bool m_ok{true};
+};
+
+// Packets off the socket, reassembling payloads split at 16 MiB. Reads are buffered, one read_some usually brings
+// in the responses of several statements.
+class PacketReader {
+public:
+	explicit PacketReader(boost::asio::ip::tcp::socket& socket)
+		: m_socket(socket) {
+	}
+
+	folly::coro::Task<std::pair<boost::system::error_code, std::string>> next() {
+		std::string payload;
+		while (true) {
+			auto ec = co_await fill(4);
+			if (ec)
+				co_return std::make_pair(ec, std::string{});
+			auto length = PayloadReader{std::string_view{m_buffer}.substr(m_pos, 4)}.fixed(3);
+			ec = co_await fill(4 + length);
+			if (ec)
+				co_return std::make_pair(ec, std::string{});
+			payload.append(m_buffer, m_pos + 4, length);
+			m_pos += 4 + length;
+			if (length < kMaxPayload)
+				co_return std::make_pair(ec, std::move(payload));
+		}
+	}
+
+private:
+	folly::coro::Task<boost::system::error_code> fill(std::size_t bytes) {
+		if (m_buffer.size() - m_pos >= bytes)
+			co_return boost::system::error_code{};
+		m_buffer.erase(0, m_pos);
+		m_pos = 0;
+		while (m_buffer.size() < bytes) {
+			auto size = m_buffer.size();
+			m_buffer.resize(std::max(size + 64 * 1024, bytes));
+			auto [ec, read] = co_await async_read_some(m_socket, boost::asio::buffer(m_buffer.data() + size, m_buffer.size() - size));
+			m_buffer.resize(size + read);
+			if (ec)
+				co_return ec;
+		}
+		co_return boost::system::error_code{};
+	}
+
+	boost::asio::ip::tcp::socket& m_socket;
+	std::string m_buffer;
+	std::size_t m_pos{0};
+};
+
+inline void appendComQuery(std::string& out, std::string_view sql) {
+	auto length = sql.size() + 1;
+	out.push_back(static_cast<char>(length & 0xff));
+	out.push_back(static_cast<char>((length >> 8) & 0xff));
+	out.push_back(static_cast<char>((length >> 16) & 0xff));
+	// every command starts a new sequence
+	out.push_back(0);
+	out.push_back(static_cast<char>(kComQuery));
+	out.append(sql);
+}
+
+inline void parseError(PayloadReader& reader, MysqlPipelineResult& result) {
+	result.error_code = static_cast<uint16_t>(reader.fixed(2));
+	auto message = reader.rest();
+	if (!message.empty() && message[0] == '#') {
+		result.sql_state = std::string{message.substr(1, 5)};
+		message.remove_prefix(std::min<std::size_t>(6, message.size()));
+	}
+	result.error_message = std::string{message};
+}
+
+// affected rows, last insert id, status flags, warnings
+inline uint16_t parseOk(PayloadReader& reader, MysqlPipelineResult& result) {
+	result.affected_rows = reader.lenenc();
+	result.last_insert_id = reader.lenenc();
+	auto status = static_cast<uint16_t>(reader.fixed(2));
+	result.warnings = static_cast<uint16_t>(reader.fixed(2));
+	return status;
+}
+
+// The response to one COM_QUERY: OK, ERR or a result set. More result sets of the same statement (a CALL) are read
+// to keep the stream in step, only the first one is kept.
+inline folly::coro::Task<boost::system::error_code> readResponse(PacketReader& packets, MysqlPipelineResult& result) {
+	bool first = true;
+	while (true) {
+		auto [ec, payload] = co_await packets.next();
+		if (ec)
+			co_return ec;
+		PayloadReader reader{payload};
+		auto header = reader.fixed(1);
+		uint16_t status = 0;
+		if (header == kErrHeader) {
+			parseError(reader, result);
+			co_return boost::system::error_code{};
+		}
+		if (header == kOkHeader) {
+			MysqlPipelineResult ok;
+			status = parseOk(reader, first ? result : ok);
+		}
+		else if (header == kNullValue) {
+			// LOCAL INFILE request, never asked for
+			co_return boost::system::error_code{boost::asio::error::operation_not_supported};
+		}
+		else {
+			PayloadReader count_reader{payload};
+			auto columns = count_reader.lenenc();
+			MysqlPipelineResult discarded;
+			auto& target = first ? result : discarded;
+			for (uint64_t i = 0; i < columns; ++i) {
+				auto [column_ec, column] = co_await packets.next();
+				if (column_ec)
+					co_return column_ec;
+				// catalog, schema, table, org_table, name
+				PayloadReader column_reader{column};
+				for (int32_t field = 0; field < 4; ++field)
+					column_reader.lenencString();
+				target.columns.emplace_back(column_reader.lenencString());
+				if (!column_reader.ok())
+					co_return boost::system::error_code{boost::asio::error::invalid_argument};
+			}
+			// without CLIENT_DEPRECATE_EOF a 5 byte EOF packet separates the column definitions from the rows
+			bool separator_seen = false;
+			while (true) {
+				auto [row_ec, row] = co_await packets.next();
+				if (row_ec)
+					co_return row_ec;
+				PayloadReader row_reader{row};
+				auto row_header = static_cast<uint8_t>(row.empty() ? 0 : row[0]);
+				if (row_header == kErrHeader) {
+					row_reader.fixed(1);
+					parseError(row_reader, target);
+					co_return boost::system::error_code{};
+				}
+				// a row starting with 0xfe would be a value of 16 MiB or more, a packet that short is the end
+				if (row_header == kEofHeader && row.size() < kMaxPayload) {
+					row_reader.fixed(1);
+					// an EOF packet is 5 bytes, the OK packet that ends the rows with CLIENT_DEPRECATE_EOF at least 7
+					if (row.size() == 5 && !separator_seen && target.rows.empty()) {
+						separator_seen = true;
+						continue;
+					}
+					if (row.size() == 5) {
+						target.warnings = static_cast<uint16_t>(row_reader.fixed(2));
+						status = static_cast<uint16_t>(row_reader.fixed(2));
+					}
+					else {
+						status = parseOk(row_reader, target);
+					}
+					break;
+				}
+				auto& values = target.rows.emplace_back();
+				values.reserve(columns);
+				for (uint64_t i = 0; i < columns; ++i)
+					values.emplace_back(row_reader.value());
+				if (!row_reader.ok())
+					co_return boost::system::error_code{boost::asio::error::invalid_argument};
+			}
+		}
+		if (!reader.ok())
+			co_return boost::system::error_code{boost::asio::error::invalid_argument};
+		first = false;
+		if (!(status & kServerMoreResultsExist))
+			co_return boost::system::error_code{};
+	}
+}
+
+} // namespace mysql_pipeline_detail
+
+// Sends every statement before waiting for any response, so n independent statements cost one round trip instead
+// of n. The server runs them in order and answers each one, a failed statement is reported in its result and does
+// not affect the others.
+//
+// The responses are read while the statements are still being written: the server answers as it reads, and once
+// its replies fill the socket buffers it stops reading until they are consumed, so writing everything first would
+// deadlock on large batches.
+//
+// boost::mysql 0.2.0 has no pipeline API: the COM_QUERY packets are written to and the responses read from the
+// connection's socket directly, which is sound between commands since nothing else is in flight then. Only text
+// statements go through the pipeline, and conn must not have an unread result set. The returned error_code is a
+// transport or protocol error, after which the connection must be discarded.
+inline folly::coro::Task<std::pair<boost::system::error_code, std::vector<MysqlPipelineResult>>> async_pipeline(
+	boost::mysql::tcp_connection& conn, const std::vector<std::string>& statements) noexcept {
+	using namespace mysql_pipeline_detail;
+	std::vector<MysqlPipelineResult> results(statements.size());
+	std::string out;
+	for (auto& sql : statements) {
+		if (sql.size() + 1 >= kMaxPayload)
+			co_return std::make_pair(boost::system::error_code{boost::asio::error::message_size}, std::move(results));
+		appendComQuery(out, sql);
+	}
+	auto& socket = conn.next_layer();
+	// either side failing cancels the other one, which would otherwise wait on a peer that stopped answering
+	auto write = [&]() -> folly::coro::Task<boost::system::error_code> {
+		auto [ec, written] = co_await async_write(socket, boost::asio::buffer(out));
+		if (ec) {
+			boost::system::error_code ignore_ec;
+			socket.cancel(ignore_ec);
+		}
+		co_return ec;
+	};
+	auto read = [&]() -> folly::coro::Task<boost::system::error_code> {
+		PacketReader packets{socket};
+		for (auto& result : results) {
+			auto ec = co_await readResponse(packets, result);
+			if (ec) {
+				boost::system::error_code ignore_ec;
+				socket.cancel(ignore_ec);
+				co_return ec;
+			}
+		}
+		co_return boost::system::error_code{};
+	};
+	auto [write_ec, read_ec] = co_await folly::coro::collectAll(write(), read());
+	// the first failure is the cause, the other side then only reports its cancellation
+	auto ec = write_ec && write_ec != boost::asio::error::operation_aborted ? write_ec : read_ec ? read_ec : write_ec;
+	co_return std::make_pair(ec, std::move(results));
+}
@@ -0,0 +1,387 @@
+#pragma once
+
+#include <sys/socket.h>
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include <spdlog/spdlog.h>
+
+#include <asio_util.hpp>
+#include <mysql_statement_cache.h>
+#include <mysql_util.hpp>
+
+struct MysqlPoolConfig {
+	std::string host{"127.0.0.1"};
+	std::string port{"3306"};
+	std::string user;
+	std::string password;
+	std::string database;
+	// per io_context: connections opened up front and kept open through idle_timeout
+	std::size_t min_size{1};
+	// per io_context: connections open, idle or acquired, before acquire queues up
+	std::size_t max_size{16};
+	std::chrono::milliseconds idle_timeout{std::chrono::seconds(60)};
+	// idle connections not heard from for this long get a SELECT 1, the server drops them after wait_timeout
+	std::chrono::milliseconds ping_interval{std::chrono::seconds(30)};
+	// how often idle connections are checked, pinged, evicted and refilled to min_size
+	std::chrono::milliseconds maintenance_interval{std::chrono::seconds(5)};
+	// how long a queued acquire waits for a connection before it fails with timed_out
+	std::chrono::milliseconds acquire_timeout{std::chrono::seconds(5)};
+	// prepared statements kept per connection, see MysqlStatementCache
+	std::size_t statement_cache_size{64};
+	bool tcp_nodelay{true};
+};
+
+struct MysqlConnection {
+	MysqlConnection(boost::asio::io_context& io_context, std::size_t statement_cache_size)
+		: conn(io_context)
+		, statements(statement_cache_size) {
+	}
+
+	boost::mysql::tcp_connection conn;
+	// live as long as the connection, the server frees them when it closes
+	MysqlStatementCache statements;
+	std::chrono::steady_clock::time_point last_used{std::chrono::steady_clock::now()};
+	// last time the server answered on this connection
+	std::chrono::steady_clock::time_point last_checked{std::chrono::steady_clock::now()};
+};
+
+class MysqlSubPool;
+
+// An acquired connection, back to its pool when the handle goes out of scope.
+class MysqlHandle final {
+public:
+	MysqlHandle() = default;
+	MysqlHandle(MysqlSubPool* pool, std::unique_ptr<MysqlConnection> connection)
+		: m_pool(pool)
+		, m_connection(std::move(connection)) {
+	}
+	~MysqlHandle() { reset(); }
+
+	MysqlHandle(MysqlHandle&& other) noexcept
+		: m_pool(std::exchange(other.m_pool, nullptr))
+		, m_connection(std::move(other.m_connection))
+		, m_reusable(other.m_reusable) {
+	}
+	MysqlHandle& operator=(MysqlHandle&& other) noexcept {
+		if (this != &other) {
+			reset();
+			m_pool = std::exchange(other.m_pool, nullptr);
+			m_connection = std::move(other.m_connection);
+			m_reusable = other.m_reusable;
+		}
+		return *this;
+	}
+	MysqlHandle(const MysqlHandle&) = delete;
+	MysqlHandle& operator=(const MysqlHandle&) = delete;
+
+	explicit operator bool() const { return m_connection != nullptr; }
+	boost::mysql::tcp_connection& operator*() { return m_connection->conn; }
+	boost::mysql::tcp_connection* operator->() { return &m_connection->conn; }
+	MysqlConnection& connection() { return *m_connection; }
+
+	// after an error or a result set left unread the protocol state is unknown, the connection is closed instead of reused
+	void discard() { m_reusable = false; }
+	void reset();
+
+private:
+	MysqlSubPool* m_pool{nullptr};
+	std::unique_ptr<MysqlConnection> m_connection;
+	bool m_reusable{true};
+};
+
+// The connections of one io_context. Like ConnectionPool it has no locks: acquire, the handles and the maintenance
+// timer all run on the io_context's thread, a handle released anywhere else is posted back to it.
+class MysqlSubPool final {
+public:
+	MysqlSubPool(boost::asio::io_context& io_context, const MysqlPoolConfig& config)
+		: m_io_context(io_context)
+		, m_config(config)
+		, m_params(m_config.user, m_config.password, m_config.database)
+		, m_maintenance_timer(io_context) {
+		boost::asio::post(m_io_context, [this] {
+			maintain();
+			scheduleMaintenance();
+		});
+	}
+	// destroy after the io_context has stopped, detached connects, pings and closes refer to the pool
+	~MysqlSubPool() { m_maintenance_timer.cancel(); }
+
+	MysqlSubPool(const MysqlSubPool&) = delete;
+	MysqlSubPool& operator=(const MysqlSubPool&) = delete;
+
+	// most recently released healthy connection first, then a new one while below max_size, then the queue
+	folly::coro::Task<std::pair<boost::system::error_code, MysqlHandle>> acquire() {
+		while (!m_idle.empty()) {
+			auto connection = std::move(m_idle.back());
+			m_idle.pop_back();
+			if (healthy(*connection)) {
+				m_reused++;
+				co_return std::make_pair(boost::system::error_code{}, MysqlHandle{this, std::move(connection)});
+			}
+			close(std::move(connection), false);
+		}
+		if (m_size < m_config.max_size) {
+			m_size++;
+			auto [ec, connection] = co_await connect();
+			if (ec) {
+				m_size--;
+				co_return std::make_pair(ec, MysqlHandle{});
+			}
+			co_return std::make_pair(ec, MysqlHandle{this, std::move(connection)});
+		}
+		Waiter waiter{m_io_context};
+		waiter.timer.expires_after(m_config.acquire_timeout);
+		m_waiters.push_back(&waiter);
+		// cancelled by put() once it hands over a connection
+		co_await timeout(waiter.timer);
+		if (!waiter.connection) {
+			std::erase(m_waiters, &waiter);
+			co_return std::make_pair(boost::system::error_code{boost::asio::error::timed_out}, MysqlHandle{});
+		}
+		m_reused++;
+		co_return std::make_pair(boost::system::error_code{}, MysqlHandle{this, std::move(waiter.connection)});
+	}
+
+	void release(std::unique_ptr<MysqlConnection> connection, bool reusable) {
+		if (!m_io_context.get_executor().running_in_this_thread()) {
+			boost::asio::post(m_io_context, [this, connection = std::move(connection), reusable]() mutable {
+				release(std::move(connection), reusable);
+			});
+			return;
+		}
+		if (!reusable || !connection->conn.next_layer().is_open()) {
+			close(std::move(connection), false);
+			return;
+		}
+		connection->last_used = std::chrono::steady_clock::now();
+		put(std::move(connection));
+	}
+
+	boost::asio::io_context& ioContext() { return m_io_context; }
+	// open connections, idle, acquired, connecting or pinged
+	std::size_t size() const { return m_size; }
+	std::size_t idleCount() const { return m_idle.size(); }
+	std::size_t waiterCount() const { return m_waiters.size(); }
+	uint64_t connectCount() const { return m_connected; }
+	uint64_t reuseCount() const { return m_reused; }
+
+private:
+	struct Waiter {
+		explicit Waiter(boost::asio::io_context& io_context)
+			: timer(io_context) {
+		}
+
+		boost::asio::steady_timer timer;
+		std::unique_ptr<MysqlConnection> connection;
+	};
+
+	// the first queued acquire takes it, the idle list otherwise
+	void put(std::unique_ptr<MysqlConnection> connection) {
+		if (!m_waiters.empty()) {
+			auto* waiter = m_waiters.front();
+			m_waiters.pop_front();
+			waiter->connection = std::move(connection);
+			waiter->timer.cancel();
+			return;
+		}
+		m_idle.emplace_back(std::move(connection));
+	}
+
+	folly::coro::Task<std::pair<boost::system::error_code, std::unique_ptr<MysqlConnection>>> connect() {
+		// the address is resolved once, connects share it until one fails
+		if (m_endpoints.empty()) {
+			auto [ec, endpoints] = co_await async_resolve(m_io_context, m_config.host, m_config.port);
+			if (ec)
+				co_return std::make_pair(ec, nullptr);
+			m_endpoints = std::move(endpoints);
+		}
+		// a copy, another connect may reset m_endpoints while this one is in flight
+		auto endpoints = m_endpoints;
+		auto connection = std::make_unique<MysqlConnection>(m_io_context, m_config.statement_cache_size);
+		auto ec = co_await async_connect(connection->conn, endpoints, m_params);
+		if (ec) {
+			m_endpoints = {};
+			co_return std::make_pair(ec, nullptr);
+		}
+		m_connected++;
+		boost::system::error_code ignore_ec;
+		connection->conn.next_layer().set_option(boost::asio::ip::tcp::no_delay(m_config.tcp_nodelay), ignore_ec);
+		connection->conn.next_layer().set_option(boost::asio::socket_base::keep_alive(true), ignore_ec);
+		co_return std::make_pair(ec, std::move(connection));
+	}
+
+	// an idle connection must have nothing to read: EOF means the server closed it, data means a stale reply
+	static bool healthy(MysqlConnection& connection) {
+		auto& socket = connection.conn.next_layer();
+		if (!socket.is_open())
+			return false;
+		char c;
+		auto ret = ::recv(socket.native_handle(), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+		return ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+	}
+
+	// graceful sends COM_QUIT first, only for a connection known to be between commands
+	void close(std::unique_ptr<MysqlConnection> connection, bool graceful) {
+		m_size--;
+		if (graceful) {
+			quit(std::move(connection)).scheduleOn(&m_executor).start();
+		}
+		else {
+			boost::system::error_code ignore_ec;
+			connection->conn.next_layer().close(ignore_ec);
+		}
+		// a queued acquire may open the freed slot
+		if (!m_waiters.empty())
+			fill();
+	}
+
+	folly::coro::Task<void> quit(std::unique_ptr<MysqlConnection> connection) {
+		co_await async_close(connection->conn);
+		co_return;
+	}
+
+	// opens one connection in the background, handed to a waiter or kept idle
+	void fill() {
+		if (m_size >= m_config.max_size)
+			return;
+		m_size++;
+		[](MysqlSubPool* pool) -> folly::coro::Task<void> {
+			auto [ec, connection] = co_await pool->connect();
+			if (ec) {
+				pool->m_size--;
+				spdlog::warn("mysql connect to {}:{} failed: {}", pool->m_config.host, pool->m_config.port, ec.message());
+				co_return;
+			}
+			pool->put(std::move(connection));
+			co_return;
+		}(this).scheduleOn(&m_executor).start();
+	}
+
+	folly::coro::Task<void> ping(std::unique_ptr<MysqlConnection> connection) {
+		auto [ec, ei, result] = co_await async_query(connection->conn, "SELECT 1");
+		if (!ec) {
+			auto [read_ec, read_ei, rows] = co_await read_all(result);
+			ec = read_ec;
+		}
+		if (ec) {
+			spdlog::warn("mysql ping failed: {}", ec.message());
+			close(std::move(connection), false);
+			co_return;
+		}
+		connection->last_checked = std::chrono::steady_clock::now();
+		put(std::move(connection));
+		co_return;
+	}
+
+	void scheduleMaintenance() {
+		m_maintenance_timer.expires_after(m_config.maintenance_interval);
+		m_maintenance_timer.async_wait([this](const boost::system::error_code& ec) {
+			if (ec)
+				return;
+			maintain();
+			scheduleMaintenance();
+		});
+	}
+
+	void maintain() {
+		auto now = std::chrono::steady_clock::now();
+		std::deque<std::unique_ptr<MysqlConnection>> idle;
+		idle.swap(m_idle);
+		for (auto& connection : idle) {
+			if (!healthy(*connection))
+				close(std::move(connection), false);
+			else if (m_size > m_config.min_size && now - connection->last_used > m_config.idle_timeout)
+				close(std::move(connection), true);
+			else if (now - connection->last_checked > m_config.ping_interval)
+				ping(std::move(connection)).scheduleOn(&m_executor).start();
+			else
+				m_idle.emplace_back(std::move(connection));
+		}
+		while (m_size < m_config.min_size)
+			fill();
+	}
+
+	boost::asio::io_context& m_io_context;
+	Executor m_executor{m_io_context};
+	const MysqlPoolConfig& m_config;
+	// refers to the strings of m_config
+	boost::mysql::connection_params m_params;
+	boost::asio::steady_timer m_maintenance_timer;
+	boost::asio::ip::tcp::resolver::results_type m_endpoints;
+	// least recently used at the front
+	std::deque<std::unique_ptr<MysqlConnection>> m_idle;
+	// acquires queued at max_size, oldest first
+	std::deque<Waiter*> m_waiters;
+	std::size_t m_size{0};
+	uint64_t m_connected{0};
+	uint64_t m_reused{0};
+};
+
+inline void MysqlHandle::reset() {
+	if (m_connection)
+		m_pool->release(std::move(m_connection), m_reusable);
+	m_pool = nullptr;
+	m_reusable = true;
+}
+
+// Pooled boost::mysql connections, one MysqlSubPool per io_context so a connection never leaves the thread that
+// runs its socket and acquire takes no lock beyond the sub pool lookup. min_size and max_size apply per io_context.
+//
+//   MysqlPool pool(config);
+//   auto [ec, conn] = co_await pool.acquire(io_context);
+//   auto [query_ec, ei, result] = co_await async_query(*conn, sql);
+class MysqlPool final {
+public:
+	explicit MysqlPool(MysqlPoolConfig config)
+		: m_config(std::move(config)) {
+		if (m_config.max_size == 0 || m_config.min_size > m_config.max_size || m_config.statement_cache_size == 0)
+			throw std::invalid_argument("MysqlPool needs 0 < max_size, min_size <= max_size and 0 < statement_cache_size");
+	}
+
+	MysqlPool(const MysqlPool&) = delete;
+	MysqlPool& operator=(const MysqlPool&) = delete;
+
+	// the awaiting coroutine must run on io_context, see Executor
+	folly::coro::Task<std::pair<boost::system::error_code, MysqlHandle>> acquire(boost::asio::io_context& io_context) {
+		co_return co_await subPool(io_context).acquire();
+	}
+
+	// created on first use, keep the reference to skip the lookup on hot paths
+	MysqlSubPool& subPool(boost::asio::io_context& io_context) {
+		{
+			std::shared_lock<std::shared_mutex> lk(m_mutex);
+			auto it = m_sub_pools.find(&io_context);
+			if (it != m_sub_pools.end())
+				return *it->second;
+		}
+		std::unique_lock<std::shared_mutex> lk(m_mutex);
+		auto& pool = m_sub_pools[&io_context];
+		if (!pool)
+			pool = std::make_unique<MysqlSubPool>(io_context, m_config);
+		return *pool;
+	}
+
+private:
+	MysqlPoolConfig m_config;
+	std::shared_mutex m_mutex;
+	std::unordered_map<boost::asio::io_context*, std::unique_ptr<MysqlSubPool>> m_sub_pools;
+};
+
+// Executes sql with params as a prepared statement cached on the connection: prepare and execute the first time, a
+// single execute round trip after that. error_info only carries the server message of a failed prepare.
+inline folly::coro::Task<std::tuple<boost::system::error_code, boost::mysql::error_info, boost::mysql::resultset<boost::asio::ip::tcp::socket>>>
+async_execute(MysqlHandle& conn, const std::string& sql, std::vector<boost::mysql::value> params) noexcept {
+	auto [ec, ei, statement] = co_await conn.connection().statements.prepare(*conn, sql);
+	if (ec)
+		co_return std::make_tuple(ec, std::move(ei), boost::mysql::resultset<boost::asio::ip::tcp::socket>{});
+	auto [execute_ec, result] = co_await async_execute(*statement, std::move(params));
+	co_return std::make_tuple(execute_ec, std::move(ei), std::move(result));
+}
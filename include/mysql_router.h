@@ -0,0 +1,394 @@
+#pragma once
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include <mysql_pool.h>
+
+struct MysqlRouterConfig {
+	MysqlPoolConfig primary;
+	// may be empty, every statement then goes to the primary
+	std::vector<MysqlPoolConfig> replicas;
+	// default of MysqlSession::setReadYourWrites, 0 turns it off
+	std::chrono::milliseconds read_your_writes{0};
+};
+
+enum class MysqlStatementKind {
+	Read,
+	Write,
+	Begin,
+	End,
+};
+
+namespace mysql_router_detail {
+
+inline bool isWordChar(char c) {
+	return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// whitespace, comments and opening parentheses ahead of the next word
+inline std::string_view skipSpace(std::string_view sql) {
+	while (!sql.empty()) {
+		if (std::isspace(static_cast<unsigned char>(sql.front())) || sql.front() == '(') {
+			sql.remove_prefix(1);
+		}
+		// a /*! ... */ comment is run by the server, it is left for the caller to see as text
+		else if (sql.starts_with("/*") && !sql.starts_with("/*!")) {
+			auto end = sql.find("*/", 2);
+			sql.remove_prefix(end == std::string_view::npos ? sql.size() : end + 2);
+		}
+		else if (sql.starts_with("#") || sql.starts_with("-- ")) {
+			auto end = sql.find('\n');
+			sql.remove_prefix(end == std::string_view::npos ? sql.size() : end + 1);
+		}
+		else {
+			break;
+		}
+	}
+	return sql;
+}
+
+// the next word upper cased, sql is advanced past it
+inline std::string nextKeyword(std::string_view& sql) {
+	sql = skipSpace(sql);
+	std::string word;
+	while (!sql.empty() && isWordChar(sql.front())) {
+		word.push_back(static_cast<char>(std::toupper(static_cast<unsigned char>(sql.front()))));
+		sql.remove_prefix(1);
+	}
+	return word;
+}
+
+// case insensitive, word must not be part of a longer identifier; npos if there is none from pos on
+inline std::size_t findWord(std::string_view sql, std::string_view word, std::size_t pos = 0) {
+	for (; pos + word.size() <= sql.size(); ++pos) {
+		if ((pos > 0 && isWordChar(sql[pos - 1])) || (pos + word.size() < sql.size() && isWordChar(sql[pos + word.size()])))
+			continue;
+		std::size_t i = 0;
+		while (i < word.size() && std::toupper(static_cast<unsigned char>(sql[pos + i])) == word[i])
+			++i;
+		if (i == word.size())
+			return pos;
+	}
+	return std::string_view::npos;
+}
+
+inline bool containsWord(std::string_view sql, std::string_view word) {
+	return findWord(sql, word) != std::string_view::npos;
+}
+
+// the words one after the other, with only whitespace or comments between them
+inline bool containsPhrase(std::string_view sql, std::initializer_list<std::string_view> words) {
+	auto first = *words.begin();
+	for (auto pos = findWord(sql, first); pos != std::string_view::npos; pos = findWord(sql, first, pos + 1)) {
+		auto rest = sql.substr(pos + first.size());
+		bool match = true;
+		for (auto it = words.begin() + 1; match && it != words.end(); ++it)
+			match = nextKeyword(rest) == *it;
+		if (match)
+			return true;
+	}
+	return false;
+}
+
+// after COMMIT or ROLLBACK: AND CHAIN opens the next transaction right away, ROLLBACK TO only undoes to a savepoint
+inline MysqlStatementKind transactionEnd(std::string_view rest) {
+	auto next = nextKeyword(rest);
+	if (next == "WORK")
+		next = nextKeyword(rest);
+	if (next == "TO" || (next == "AND" && nextKeyword(rest) == "CHAIN"))
+		return MysqlStatementKind::Write;
+	return MysqlStatementKind::End;
+}
+
+} // namespace mysql_router_detail
+
+// Whether sql may run on a replica. Only plain SELECT, SHOW, DESCRIBE and EXPLAIN are reads, and not when they lock
+// rows, write into variables or files, call a function whose result depends on the session or changes state, or
+// name a data change: EXPLAIN ANALYZE runs the statement it explains.
+// The check is on words rather than a parse, a match inside a string literal sends a read to the primary, which
+// costs load but never correctness.
+inline MysqlStatementKind mysql_statement_kind(std::string_view sql) {
+	using namespace mysql_router_detail;
+	auto rest = sql;
+	auto first = nextKeyword(rest);
+	if (first == "BEGIN" || (first == "START" && nextKeyword(rest) == "TRANSACTION"))
+		return MysqlStatementKind::Begin;
+	if (first == "COMMIT" || first == "ROLLBACK")
+		return transactionEnd(rest);
+	if (first != "SELECT" && first != "SHOW" && first != "DESCRIBE" && first != "DESC" && first != "EXPLAIN")
+		return MysqlStatementKind::Write;
+	if (sql.find('@') != std::string_view::npos)
+		return MysqlStatementKind::Write;
+	for (auto word : {"UPDATE", "DELETE", "INSERT", "REPLACE", "SHARE", "INTO", "GET_LOCK", "RELEASE_LOCK", "IS_USED_LOCK",
+			 "LAST_INSERT_ID", "FOUND_ROWS", "ROW_COUNT", "NEXTVAL", "SETVAL", "LASTVAL"}) {
+		if (containsWord(sql, word))
+			return MysqlStatementKind::Write;
+	}
+	// MariaDB's sequence syntax, PREVIOUS VALUE FOR is the session's last one like LASTVAL
+	if (containsPhrase(sql, {"NEXT", "VALUE", "FOR"}) || containsPhrase(sql, {"PREVIOUS", "VALUE", "FOR"}))
+		return MysqlStatementKind::Write;
+	return MysqlStatementKind::Read;
+}
+
+// A primary and its replicas, one MysqlPool each. Statements are routed by MysqlSession, the router only holds the
+// pools and the count of reads in flight per replica, shared by every io_context.
+//
+//   MysqlRouter router(config);
+//   MysqlSession session(router, io_context);
+//   auto [ec, ei, result] = co_await session.query("SELECT name FROM users WHERE id = 1");
+class MysqlRouter final {
+public:
+	explicit MysqlRouter(MysqlRouterConfig config)
+		: m_config(std::move(config))
+		, m_primary(m_config.primary) {
+		for (auto& replica : m_config.replicas)
+			m_replicas.emplace_back(std::make_unique<Replica>(replica));
+	}
+
+	MysqlRouter(const MysqlRouter&) = delete;
+	MysqlRouter& operator=(const MysqlRouter&) = delete;
+
+	const MysqlRouterConfig& config() const { return m_config; }
+	MysqlPool& primary() { return m_primary; }
+	MysqlPool& replica(std::size_t index) { return m_replicas[index]->pool; }
+	std::size_t replicaCount() const { return m_replicas.size(); }
+
+	// The replica with the fewest reads in flight, ties rotate so idle replicas share the load. Its count is taken
+	// until done(index).
+	std::size_t pickReplica() {
+		if (m_replicas.empty())
+			throw std::logic_error("MysqlRouter without replicas");
+		auto size = m_replicas.size();
+		auto start = m_next.fetch_add(1, std::memory_order_relaxed) % size;
+		auto best = start;
+		auto best_outstanding = m_replicas[start]->outstanding.load(std::memory_order_relaxed);
+		for (std::size_t i = 1; i < size; ++i) {
+			auto index = (start + i) % size;
+			auto outstanding = m_replicas[index]->outstanding.load(std::memory_order_relaxed);
+			if (outstanding < best_outstanding) {
+				best = index;
+				best_outstanding = outstanding;
+			}
+		}
+		m_replicas[best]->outstanding.fetch_add(1, std::memory_order_relaxed);
+		m_replicas[best]->reads.fetch_add(1, std::memory_order_relaxed);
+		return best;
+	}
+
+	void done(std::size_t index) { m_replicas[index]->outstanding.fetch_sub(1, std::memory_order_relaxed); }
+
+	int64_t outstanding(std::size_t index) const { return m_replicas[index]->outstanding.load(std::memory_order_relaxed); }
+	uint64_t reads(std::size_t index) const { return m_replicas[index]->reads.load(std::memory_order_relaxed); }
+
+private:
+	struct Replica {
+		explicit Replica(const MysqlPoolConfig& config)
+			: pool(config) {
+		}
+
+		MysqlPool pool;
+		std::atomic<int64_t> outstanding{0};
+		std::atomic<uint64_t> reads{0};
+	};
+
+	MysqlRouterConfig m_config;
+	MysqlPool m_primary;
+	std::vector<std::unique_ptr<Replica>> m_replicas;
+	std::atomic<std::size_t> m_next{0};
+};
+
+// A sequence of statements of one client, routed one by one: reads to the replica with the fewest reads in flight,
+// everything else to the primary. From BEGIN or START TRANSACTION to COMMIT or ROLLBACK every statement, reads
+// included, runs on the one primary connection that holds the transaction. Transactions opened any other way (SET
+// autocommit = 0, XA) are not tracked, send them through the primary's pool.
+//
+// With a read your writes window, reads go to the primary for that long after the session's last write or
+// transaction, so the session sees its own changes however far the replicas lag. Reads that find no replica
+// connection go to the primary too.
+//
+// A statement holds its connection, and on a replica one of its reads in flight, until its result set is read: a
+// statement without rows gives both back on its own, after reading rows call done(), or use queryAll() and
+// executeAll() which read everything and give back before returning. Inside a transaction done() keeps the primary
+// connection for the next statement. A result set not finished with done() is held until the next statement, and
+// must be read completely before it, as on a plain connection. A server error (a duplicate key, a syntax error) only
+// fails its statement. A transport or protocol error closes the connection; inside a transaction that rolls the
+// transaction back and the session is out of it. Like MysqlSubPool, a session must only be used from its io_context.
+class MysqlSession final {
+public:
+	MysqlSession(MysqlRouter& router, boost::asio::io_context& io_context)
+		: m_router(router)
+		, m_primary(router.primary().subPool(io_context))
+		, m_read_your_writes(router.config().read_your_writes) {
+		for (std::size_t i = 0; i < router.replicaCount(); ++i)
+			m_replicas.emplace_back(&router.replica(i).subPool(io_context));
+	}
+	~MysqlSession() { release(); }
+
+	MysqlSession(const MysqlSession&) = delete;
+	MysqlSession& operator=(const MysqlSession&) = delete;
+
+	folly::coro::Task<std::tuple<boost::system::error_code, boost::mysql::error_info, boost::mysql::resultset<boost::asio::ip::tcp::socket>>> query(
+		const std::string& sql) {
+		auto kind = mysql_statement_kind(sql);
+		auto ec = co_await route(kind);
+		if (ec)
+			co_return std::make_tuple(ec, boost::mysql::error_info{}, boost::mysql::resultset<boost::asio::ip::tcp::socket>{});
+		auto result = co_await async_query(*m_conn, sql);
+		finish(kind, std::get<0>(result));
+		if (std::get<0>(result) || std::get<2>(result).complete())
+			done();
+		co_return result;
+	}
+
+	// through the statement cache of the connection, see async_execute(MysqlHandle&, ...)
+	folly::coro::Task<std::tuple<boost::system::error_code, boost::mysql::error_info, boost::mysql::resultset<boost::asio::ip::tcp::socket>>> execute(
+		const std::string& sql, std::vector<boost::mysql::value> params) {
+		auto kind = mysql_statement_kind(sql);
+		auto ec = co_await route(kind);
+		if (ec)
+			co_return std::make_tuple(ec, boost::mysql::error_info{}, boost::mysql::resultset<boost::asio::ip::tcp::socket>{});
+		auto result = co_await async_execute(m_conn, sql, std::move(params));
+		finish(kind, std::get<0>(result));
+		if (std::get<0>(result) || std::get<2>(result).complete())
+			done();
+		co_return result;
+	}
+
+	// query() and read_all() in one, the connection and the replica are given back before it returns
+	folly::coro::Task<std::tuple<boost::system::error_code, boost::mysql::error_info, std::vector<boost::mysql::row>>> queryAll(
+		const std::string& sql) {
+		auto [ec, ei, result] = co_await query(sql);
+		if (ec)
+			co_return std::make_tuple(ec, std::move(ei), std::vector<boost::mysql::row>{});
+		co_return co_await readAll(result);
+	}
+
+	folly::coro::Task<std::tuple<boost::system::error_code, boost::mysql::error_info, std::vector<boost::mysql::row>>> executeAll(
+		const std::string& sql, std::vector<boost::mysql::value> params) {
+		auto [ec, ei, result] = co_await execute(sql, std::move(params));
+		if (ec)
+			co_return std::make_tuple(ec, std::move(ei), std::vector<boost::mysql::row>{});
+		co_return co_await readAll(result);
+	}
+
+	// The result set of the last statement is read: its replica read is no longer in flight and, outside a
+	// transaction, its connection goes back to the pool.
+	void done() {
+		if (!m_in_transaction)
+			release();
+	}
+
+	// 0 turns the window off
+	void setReadYourWrites(std::chrono::milliseconds window) { m_read_your_writes = window; }
+
+	// Gives the connection back to its pool. A transaction still open is rolled back by closing its connection.
+	void release() {
+		if (m_in_transaction) {
+			m_conn.discard();
+			m_in_transaction = false;
+		}
+		m_conn.reset();
+		if (m_replica != kPrimary) {
+			m_router.done(m_replica);
+			m_replica = kPrimary;
+		}
+	}
+
+	bool inTransaction() const { return m_in_transaction; }
+	// whether the last statement ran on a replica
+	bool onReplica() const { return m_on_replica; }
+	uint64_t primaryStatements() const { return m_primary_statements; }
+	uint64_t replicaStatements() const { return m_replica_statements; }
+
+private:
+	static constexpr std::size_t kPrimary = std::numeric_limits<std::size_t>::max();
+
+	folly::coro::Task<std::tuple<boost::system::error_code, boost::mysql::error_info, std::vector<boost::mysql::row>>> readAll(
+		boost::mysql::resultset<boost::asio::ip::tcp::socket>& result) {
+		if (result.complete())
+			co_return std::make_tuple(boost::system::error_code{}, boost::mysql::error_info{}, std::vector<boost::mysql::row>{});
+		auto rows = co_await read_all(result);
+		finish(MysqlStatementKind::Read, std::get<0>(rows));
+		done();
+		co_return rows;
+	}
+
+	folly::coro::Task<boost::system::error_code> route(MysqlStatementKind kind) {
+		m_on_replica = false;
+		if (m_in_transaction && m_conn) {
+			m_primary_statements++;
+			co_return boost::system::error_code{};
+		}
+		release();
+		if (kind == MysqlStatementKind::Read && !m_replicas.empty() && !recentWrite()) {
+			auto index = m_router.pickReplica();
+			auto [ec, conn] = co_await m_replicas[index]->acquire();
+			if (!ec) {
+				m_conn = std::move(conn);
+				m_replica = index;
+				m_on_replica = true;
+				m_replica_statements++;
+				co_return ec;
+			}
+			m_router.done(index);
+			spdlog::warn("mysql replica {}:{} unavailable, read goes to the primary: {}", m_router.config().replicas[index].host,
+				m_router.config().replicas[index].port, ec.message());
+		}
+		auto [ec, conn] = co_await m_primary.acquire();
+		if (ec)
+			co_return ec;
+		m_conn = std::move(conn);
+		m_primary_statements++;
+		co_return ec;
+	}
+
+	void finish(MysqlStatementKind kind, const boost::system::error_code& ec) {
+		if (kind != MysqlStatementKind::Read || m_in_transaction) {
+			m_last_write = std::chrono::steady_clock::now();
+			m_wrote = true;
+		}
+		// a server error only fails the statement, as it would on a plain connection the transaction goes on
+		if (mysql_server_error(ec))
+			return;
+		if (ec) {
+			m_conn.discard();
+			m_in_transaction = false;
+			release();
+			return;
+		}
+		if (kind == MysqlStatementKind::Begin)
+			m_in_transaction = true;
+		else if (kind == MysqlStatementKind::End)
+			m_in_transaction = false;
+	}
+
+	bool recentWrite() const {
+		return m_wrote && m_read_your_writes.count() > 0 && std::chrono::steady_clock::now() - m_last_write < m_read_your_writes;
+	}
+
+	MysqlRouter& m_router;
+	MysqlSubPool& m_primary;
+	std::vector<MysqlSubPool*> m_replicas;
+	std::chrono::milliseconds m_read_your_writes;
+	MysqlHandle m_conn;
+	// replica of m_conn, kPrimary when it is a primary connection or there is none
+	std::size_t m_replica{kPrimary};
+	bool m_on_replica{false};
+	bool m_in_transaction{false};
+	bool m_wrote{false};
+	std::chrono::steady_clock::time_point m_last_write{};
+	uint64_t m_primary_statements{0};
+	uint64_t m_replica_statements{0};
+};
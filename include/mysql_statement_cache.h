@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+#include <mysql_util.hpp>
+
+// Prepared statements of one connection keyed by their SQL text, so a query after the first is a single execute
+// round trip instead of a prepare, a server side parse and an execute. Least recently used statements are closed on
+// the server once capacity is reached, which keeps the connection under max_prepared_stmt_count.
+//
+// Like the connection it belongs to, the cache must only be used by one coroutine at a time.
+class MysqlStatementCache final {
+public:
+	using Statement = boost::mysql::prepared_statement<boost::asio::ip::tcp::socket>;
+
+	explicit MysqlStatementCache(std::size_t capacity)
+		: m_capacity(capacity) {
+		if (capacity == 0)
+			throw std::invalid_argument("MysqlStatementCache capacity is 0");
+	}
+
+	MysqlStatementCache(const MysqlStatementCache&) = delete;
+	MysqlStatementCache& operator=(const MysqlStatementCache&) = delete;
+
+	// The statement stays valid until the next prepare on this cache, which may evict it.
+	folly::coro::Task<std::tuple<boost::system::error_code, boost::mysql::error_info, Statement*>> prepare(boost::mysql::tcp_connection& conn,
+		const std::string& sql) {
+		if (auto it = m_index.find(sql); it != m_index.end()) {
+			m_hits++;
+			m_lru.splice(m_lru.begin(), m_lru, it->second);
+			co_return std::make_tuple(boost::system::error_code{}, boost::mysql::error_info{}, &it->second->second);
+		}
+		m_misses++;
+		if (m_lru.size() >= m_capacity) {
+			auto [ec, ei] = co_await async_close(m_lru.back().second);
+			m_index.erase(m_lru.back().first);
+			m_lru.pop_back();
+			m_evictions++;
+			if (ec)
+				co_return std::make_tuple(ec, std::move(ei), nullptr);
+		}
+		auto [ec, ei, statement] = co_await async_prepare_statement(conn, sql);
+		if (ec)
+			co_return std::make_tuple(ec, std::move(ei), nullptr);
+		m_lru.emplace_front(sql, std::move(statement));
+		m_index.emplace(m_lru.front().first, m_lru.begin());
+		co_return std::make_tuple(ec, std::move(ei), &m_lru.front().second);
+	}
+
+	std::size_t size() const { return m_lru.size(); }
+	uint64_t hitCount() const { return m_hits; }
+	uint64_t missCount() const { return m_misses; }
+	uint64_t evictionCount() const { return m_evictions; }
+
+private:
+	using Entry = std::pair<std::string, Statement>;
+
+	std::size_t m_capacity;
+	// most recently used at the front
+	std::list<Entry> m_lru;
+	// keys view the sql of the list entries
+	std::unordered_map<std::string_view, std::list<Entry>::iterator> m_index;
+	uint64_t m_hits{0};
+	uint64_t m_misses{0};
+	uint64_t m_evictions{0};
+};
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <folly/experimental/coro/AsyncGenerator.h>
+#include <folly/experimental/coro/Task.h>
+#include <boost/mysql.hpp>
+
+#include <happy_eyeballs.h>
+
+// Coroutine awaiters over the boost::mysql tcp_connection, each resumes the awaiting coroutine from the completion
+// handler on the connection's io_context.
+
+// An error the server answered with, a duplicate key or a syntax error: only the statement failed and the connection
+// is fine. Anything else, a transport error or a client side protocol error (errc from incomplete_message on), leaves
+// the protocol state unknown.
+inline bool mysql_server_error(const boost::system::error_code& ec) {
+	return ec && ec.category() == boost::system::error_code{boost::mysql::errc::ok}.category() &&
+		ec.value() < static_cast<int>(boost::mysql::errc::incomplete_message);
+}
+
+class MysqlConnectAwaiter {
+public:
+	MysqlConnectAwaiter(boost::mysql::tcp_connection& conn, boost::asio::ip::tcp::resolver::results_type& ep, boost::mysql::connection_params& conn_params)
+		: m_conn(conn)
+		, m_ep(ep)
+		, m_conn_params(conn_params) {
+	}
+
+	bool await_ready() const noexcept { return false; }
+	// race the resolved endpoints on the socket, then run the mysql handshake on the winner
+	void await_suspend(std::coroutine_handle<> handle) {
+		async_connect_happy_eyeballs(m_conn.next_layer(), m_ep, {}, [this, handle](boost::system::error_code ec, boost::asio::ip::tcp::endpoint) {
+			if (ec) {
+				m_ec = std::move(ec);
+				handle.resume();
+				return;
+			}
+			m_conn.async_handshake(m_conn_params, m_additional_info, [this, handle](boost::system::error_code ec) {
+				m_ec = std::move(ec);
+				handle.resume();
+			});
+		});
+	}
+	auto await_resume() noexcept { return m_ec; }
+
+private:
+	boost::mysql::tcp_connection& m_conn;
+	boost::asio::ip::tcp::resolver::results_type& m_ep;
+	boost::mysql::connection_params& m_conn_params;
+	boost::system::error_code m_ec{};
+	boost::mysql::error_info m_additional_info;
+};
+
+inline folly::coro::Task<boost::system::error_code> async_connect(boost::mysql::tcp_connection& conn,
+	boost::asio::ip::tcp::resolver::results_type& ep, boost::mysql::connection_params& conn_params) noexcept {
+	co_return co_await MysqlConnectAwaiter{conn, ep, conn_params};
+}
+
+class ResolveAwaiter {
+public:
+	ResolveAwaiter(boost::asio::io_context& io_context, const std::string& host, const std::string& port)
+		: io_context_(io_context)
+		, m_resolver(io_context.get_executor())
+		, m_host(host)
+		, m_port(port) {
+	}
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) {
+		m_resolver.async_resolve(m_host.c_str(), m_port.c_str(),
+			[this, handle](boost::system::error_code ec, boost::asio::ip::tcp::resolver::results_type results) {
+				m_ec = std::move(ec);
+				m_results_type = std::move(results);
+				handle.resume();
+			});
+	}
+	auto await_resume() noexcept {
+		return std::make_pair(std::move(m_ec), std::move(m_results_type));
+	}
+
+private:
+	boost::asio::io_context& io_context_;
+	boost::asio::ip::tcp::resolver m_resolver;
+	std::string m_host;
+	std::string m_port;
+	boost::system::error_code m_ec{};
+	boost::asio::ip::tcp::resolver::results_type m_results_type;
+};
+
+inline folly::coro::Task<std::pair<boost::system::error_code, boost::asio::ip::tcp::resolver::results_type>> async_resolve(boost::asio::io_context& io_context,
+	const std::string& host, const std::string& port) noexcept {
+	co_return co_await ResolveAwaiter{io_context, host, port};
+}
+
+class QueryAwaiter {
+public:
+	QueryAwaiter(boost::mysql::tcp_connection& tcp_connection, const std::string& sql)
+		: m_tcp_connection(tcp_connection)
+		, m_sql(sql) {
+	}
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) {
+		m_tcp_connection.async_query(m_sql.c_str(), m_additional_info, [this, handle](boost::system::error_code ec, auto&& result) {
+			m_ec = std::move(ec);
+			m_resultset = std::move(result);
+			handle.resume();
+		});
+	}
+	auto await_resume() noexcept {
+		return std::make_tuple(std::move(m_ec), std::move(m_additional_info), std::move(m_resultset));
+	}
+
+private:
+	boost::mysql::tcp_connection& m_tcp_connection;
+	std::string m_sql;
+	boost::system::error_code m_ec{};
+	boost::mysql::error_info m_additional_info;
+	boost::mysql::resultset<boost::asio::ip::tcp::socket> m_resultset;
+};
+
+inline folly::coro::Task<std::tuple<boost::system::error_code, boost::mysql::error_info, boost::mysql::resultset<boost::asio::ip::tcp::socket>>> async_query(
+	boost::mysql::tcp_connection& tcp_connection, const std::string& sql) noexcept {
+	co_return co_await QueryAwaiter{tcp_connection, sql};
+}
+
+class ReadAllAwaiter {
+public:
+	ReadAllAwaiter(boost::mysql::resultset<boost::asio::ip::tcp::socket>& resultset)
+		: m_resultset(resultset) {
+	}
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) {
+		m_resultset.async_read_all(m_additional_info, [this, handle](boost::system::error_code ec, std::vector<boost::mysql::row>&& rows) {
+			m_rows = std::move(rows);
+			m_ec = std::move(ec);
+			handle.resume();
+		});
+	}
+	auto await_resume() noexcept {
+		return std::make_tuple(std::move(m_ec), std::move(m_additional_info), std::move(m_rows));
+	}
+
+private:
+	boost::mysql::resultset<boost::asio::ip::tcp::socket>& m_resultset;
+	boost::system::error_code m_ec{};
+	boost::mysql::error_info m_additional_info{};
+	std::vector<boost::mysql::row> m_rows;
+};
+
+inline folly::coro::Task<std::tuple<boost::system::error_code, boost::mysql::error_info, std::vector<boost::mysql::row>>> read_all(
+	boost::mysql::resultset<boost::asio::ip::tcp::socket>& resultset) noexcept {
+	co_return co_await ReadAllAwaiter{resultset};
+}
+
+class PrepareStatementAwaiter {
+public:
+	PrepareStatementAwaiter(boost::mysql::tcp_connection& tcp_connection, const std::string& sql)
+		: m_tcp_connection(tcp_connection)
+		, m_sql(sql) {
+	}
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) {
+		m_tcp_connection.async_prepare_statement(m_sql.c_str(), m_additional_info, [this, handle](boost::system::error_code ec, auto&& result) {
+			m_ec = std::move(ec);
+			m_prepared_statement = std::move(result);
+			handle.resume();
+		});
+	}
+	auto await_resume() noexcept {
+		return std::make_tuple(std::move(m_ec), std::move(m_additional_info), std::move(m_prepared_statement));
+	}
+
+private:
+	boost::mysql::tcp_connection& m_tcp_connection;
+	std::string m_sql;
+	boost::system::error_code m_ec{};
+	boost::mysql::error_info m_additional_info{};
+	boost::mysql::prepared_statement<boost::asio::ip::tcp::socket> m_prepared_statement;
+};
+
+inline folly::coro::Task<std::tuple<boost::system::error_code, boost::mysql::error_info, boost::mysql::prepared_statement<boost::asio::ip::tcp::socket>>> async_prepare_statement(
+	boost::mysql::tcp_connection& tcp_connection, const std::string& sql) noexcept {
+	co_return co_await PrepareStatementAwaiter{tcp_connection, sql};
+}
+
+class AsyncExecuteAwaiter {
+public:
+	AsyncExecuteAwaiter(boost::mysql::prepared_statement<boost::asio::ip::tcp::socket>& stmt, std::vector<boost::mysql::value> params)
+		: m_stmt(stmt)
+		, m_params(std::move(params)) {
+	}
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) {
+		m_stmt.async_execute(m_params, m_additional_info, [this, handle](boost::system::error_code ec, auto&& result) {
+			m_ec = std::move(ec);
+			m_resultset = std::move(result);
+			handle.resume();
+		});
+	}
+	auto await_resume() noexcept {
+		return std::make_pair(std::move(m_ec), std::move(m_resultset));
+	}
+
+private:
+	boost::mysql::prepared_statement<boost::asio::ip::tcp::socket>& m_stmt;
+	std::vector<boost::mysql::value> m_params;
+
+	boost::system::error_code m_ec{};
+	boost::mysql::error_info m_additional_info{};
+	boost::mysql::resultset<boost::asio::ip::tcp::socket> m_resultset;
+};
+
+inline folly::coro::Task<std::pair<boost::system::error_code, boost::mysql::resultset<boost::asio::ip::tcp::socket>>> async_execute(
+	boost::mysql::prepared_statement<boost::asio::ip::tcp::socket>& stmt, std::vector<boost::mysql::value> params) noexcept {
+	co_return co_await AsyncExecuteAwaiter{stmt, std::move(params)};
+}
+
+class AsyncCloseAwaiter {
+public:
+	AsyncCloseAwaiter(boost::mysql::tcp_connection& tcp_connection)
+		: m_tcp_connection(tcp_connection) {
+	}
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) {
+		m_tcp_connection.async_close(m_additional_info, [this, handle](boost::system::error_code ec) {
+			m_ec = std::move(ec);
+			handle.resume();
+		});
+	}
+	auto await_resume() noexcept {
+		return std::make_tuple(std::move(m_ec), std::move(m_additional_info));
+	}
+
+private:
+	boost::mysql::tcp_connection& m_tcp_connection;
+	boost::system::error_code m_ec{};
+	boost::mysql::error_info m_additional_info{};
+};
+
+inline folly::coro::Task<std::tuple<boost::system::error_code, boost::mysql::error_info>> async_close(
+	boost::mysql::tcp_connection& tcp_connection) noexcept {
+	co_return co_await AsyncCloseAwaiter{tcp_connection};
+}
+
+// COM_STMT_CLOSE, the server frees the statement. There is no response, so this costs a write and no round trip.
+class StatementCloseAwaiter {
+public:
+	StatementCloseAwaiter(boost::mysql::prepared_statement<boost::asio::ip::tcp::socket>& stmt)
+		: m_stmt(stmt) {
+	}
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) {
+		m_stmt.async_close(m_additional_info, [this, handle](boost::system::error_code ec) {
+			m_ec = std::move(ec);
+			handle.resume();
+		});
+	}
+	auto await_resume() noexcept {
+		return std::make_tuple(std::move(m_ec), std::move(m_additional_info));
+	}
+
+private:
+	boost::mysql::prepared_statement<boost::asio::ip::tcp::socket>& m_stmt;
+	boost::system::error_code m_ec{};
+	boost::mysql::error_info m_additional_info{};
+};
+
+inline folly::coro::Task<std::tuple<boost::system::error_code, boost::mysql::error_info>> async_close(
+	boost::mysql::prepared_statement<boost::asio::ip::tcp::socket>& stmt) noexcept {
+	co_return co_await StatementCloseAwaiter{stmt};
+}
+
+class ReadManyAwaiter {
+public:
+	ReadManyAwaiter(boost::mysql::resultset<boost::asio::ip::tcp::socket>& resultset, std::size_t count)
+		: m_resultset(resultset)
+		, m_count(count) {
+	}
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) {
+		m_resultset.async_read_many(m_count, m_additional_info, [this, handle](boost::system::error_code ec, std::vector<boost::mysql::row>&& rows) {
+			m_rows = std::move(rows);
+			m_ec = std::move(ec);
+			handle.resume();
+		});
+	}
+	auto await_resume() noexcept {
+		return std::make_tuple(std::move(m_ec), std::move(m_additional_info), std::move(m_rows));
+	}
+
+private:
+	boost::mysql::resultset<boost::asio::ip::tcp::socket>& m_resultset;
+	std::size_t m_count;
+	boost::system::error_code m_ec{};
+	boost::mysql::error_info m_additional_info{};
+	std::vector<boost::mysql::row> m_rows;
+};
+
+// at most count rows, fewer once the result set completes
+inline folly::coro::Task<std::tuple<boost::system::error_code, boost::mysql::error_info, std::vector<boost::mysql::row>>> read_many(
+	boost::mysql::resultset<boost::asio::ip::tcp::socket>& resultset, std::size_t count) noexcept {
+	co_return co_await ReadManyAwaiter{resultset, count};
+}
+
+// The rows of resultset one by one as they come off the socket, instead of read_all's vector of the whole result set.
+// At most batch_size rows are held at a time and the first one is yielded after the first batch, not the last.
+// A read error is thrown as boost::system::system_error, the connection must not be reused after it.
+//
+//   auto rows = stream_rows(result);
+//   while (auto row = co_await rows.next())
+//       process(*row);
+inline folly::coro::AsyncGenerator<boost::mysql::row&&> stream_rows(boost::mysql::resultset<boost::asio::ip::tcp::socket>& resultset,
+	std::size_t batch_size = 256) {
+	while (!resultset.complete()) {
+		auto [ec, ei, rows] = co_await read_many(resultset, batch_size);
+		if (ec)
+			throw boost::system::system_error(ec, ei.message());
+		for (auto& row : rows)
+			co_yield std::move(row);
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <yaml_cpp_struct.hpp>
+
+// Socket options applied to every accepted connection, selected by name from ServerConfig::socket_profiles.
+struct SocketProfile {
+	bool tcp_nodelay;
+	bool keep_alive;
+	std::optional<int32_t> recv_buffer_size;
+	std::optional<int32_t> send_buffer_size;
+};
+YCS_ADD_STRUCT(SocketProfile, tcp_nodelay, keep_alive, recv_buffer_size, send_buffer_size)
+
+struct TlsConfig {
+	std::string cert_file;
+	std::string key_file;
+	// hand the record layer to kernel TLS after the handshake, needs OpenSSL 3 and the tls kernel module
+	bool ktls;
+	bool session_tickets;
+};
+YCS_ADD_STRUCT(TlsConfig, cert_file, key_file, ktls, session_tickets)
+
+struct HotRestartConfig {
+	// unix socket the running generation listens on for its successor
+	std::string socket_path;
+	// also hand over idle plain tcp connections, TLS sessions are always drained
+	bool transfer_connections;
+	// how long the old generation waits for sessions to hand over or finish before it exits
+	std::chrono::milliseconds drain_timeout;
+};
+YCS_ADD_STRUCT(HotRestartConfig, socket_path, transfer_connections, drain_timeout)
+
+struct ServerConfig {
+	std::string host;
+	uint16_t port;
+	int32_t backlog;
+	bool reuse_address;
+	// one io_context and one thread per entry, threads are pinned to cpu_affinity[i % size] when set
+	int32_t io_context_pool_size;
+	std::optional<std::vector<int32_t>> cpu_affinity;
+	int32_t read_buffer_size;
+	std::string socket_profile;
+	std::unordered_map<std::string, SocketProfile> socket_profiles;
+	// a session without any inbound data for idle_timeout is closed
+	std::chrono::milliseconds idle_timeout;
+	std::optional<TlsConfig> tls;
+	std::optional<HotRestartConfig> hot_restart;
+};
+YCS_ADD_STRUCT(ServerConfig, host, port, backlog, reuse_address, io_context_pool_size, cpu_affinity, read_buffer_size,
+	socket_profile, socket_profiles, idle_timeout, tls, hot_restart)
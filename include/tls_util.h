@@ -0,0 +1,226 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <asio_util.hpp>
+#include <server_config.h>
+
+inline void configure_tls_context(SSL_CTX* ctx, bool ktls, bool session_tickets) {
+#ifdef SSL_OP_ENABLE_KTLS
+	if (ktls)
+		SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
+	if (!session_tickets)
+		SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+}
+
+inline boost::asio::ssl::context make_tls_server_context(const TlsConfig& config) {
+	boost::asio::ssl::context ctx(boost::asio::ssl::context::tls_server);
+	ctx.set_options(boost::asio::ssl::context::default_workarounds | boost::asio::ssl::context::no_sslv2 |
+					boost::asio::ssl::context::no_sslv3 | boost::asio::ssl::context::no_tlsv1 | boost::asio::ssl::context::no_tlsv1_1);
+	ctx.use_certificate_chain_file(config.cert_file);
+	ctx.use_private_key_file(config.key_file, boost::asio::ssl::context::pem);
+	configure_tls_context(ctx.native_handle(), config.ktls, config.session_tickets);
+	SSL_CTX_set_session_cache_mode(ctx.native_handle(), SSL_SESS_CACHE_SERVER);
+	return ctx;
+}
+
+inline boost::asio::ssl::context make_tls_client_context(bool ktls) {
+	boost::asio::ssl::context ctx(boost::asio::ssl::context::tls_client);
+	ctx.set_options(boost::asio::ssl::context::default_workarounds | boost::asio::ssl::context::no_sslv2 |
+					boost::asio::ssl::context::no_sslv3 | boost::asio::ssl::context::no_tlsv1 | boost::asio::ssl::context::no_tlsv1_1);
+	configure_tls_context(ctx.native_handle(), ktls, true);
+	return ctx;
+}
+
+// Client side session-ticket store, keyed by SNI. Every connection that goes through prepare() offers the
+// last ticket the server handed out, so reconnects skip the full key exchange.
+class TlsSessionCache final {
+public:
+	explicit TlsSessionCache(SSL_CTX* ctx) {
+		SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+		SSL_CTX_set_app_data(ctx, this);
+		SSL_CTX_sess_set_new_cb(ctx, &TlsSessionCache::onNewSession);
+	}
+	TlsSessionCache(const TlsSessionCache&) = delete;
+	TlsSessionCache& operator=(const TlsSessionCache&) = delete;
+
+	~TlsSessionCache() {
+		for (auto& [_, session] : m_sessions)
+			SSL_SESSION_free(session);
+	}
+
+	void prepare(SSL* ssl, const std::string& server_name) {
+		SSL_set_tlsext_host_name(ssl, server_name.c_str());
+		std::lock_guard<std::mutex> lk(m_mutex);
+		if (auto it = m_sessions.find(server_name); it != m_sessions.end())
+			SSL_set_session(ssl, it->second);
+	}
+
+private:
+	static int onNewSession(SSL* ssl, SSL_SESSION* session) {
+		auto self = static_cast<TlsSessionCache*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+		auto server_name = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+		if (self == nullptr || server_name == nullptr)
+			return 0;
+		std::lock_guard<std::mutex> lk(self->m_mutex);
+		auto [it, inserted] = self->m_sessions.emplace(server_name, session);
+		if (!inserted) {
+			SSL_SESSION_free(it->second);
+			it->second = session;
+		}
+		// we keep the reference
+		return 1;
+	}
+
+	std::mutex m_mutex;
+	std::unordered_map<std::string, SSL_SESSION*> m_sessions;
+};
+
+// TLS directly on the socket fd. boost::asio::ssl::stream feeds OpenSSL through a memory BIO pair, which rules
+// out kernel TLS; with a socket BIO OpenSSL 3 installs the negotiated keys into the kernel once the handshake
+// is done (SSL_OP_ENABLE_KTLS), after which SSL_read/SSL_write are plain recv/send and SSL_sendfile is zero copy.
+// Without kernel support everything still works with user space crypto.
+class TlsSocket final {
+public:
+	TlsSocket(boost::asio::ip::tcp::socket socket, SSL_CTX* ctx)
+		: m_socket(std::move(socket))
+		, m_ssl(SSL_new(ctx), SSL_free) {
+	}
+
+	boost::asio::ip::tcp::socket& lowest_layer() { return m_socket; }
+	SSL* native_handle() { return m_ssl.get(); }
+
+	bool ktlsSend() const {
+#ifdef SSL_OP_ENABLE_KTLS
+		return BIO_get_ktls_send(SSL_get_wbio(m_ssl.get()));
+#else
+		return false;
+#endif
+	}
+
+	bool ktlsRecv() const {
+#ifdef SSL_OP_ENABLE_KTLS
+		return BIO_get_ktls_recv(SSL_get_rbio(m_ssl.get()));
+#else
+		return false;
+#endif
+	}
+
+	folly::coro::Task<boost::system::error_code> handshake(boost::asio::ssl::stream_base::handshake_type type) {
+		boost::system::error_code ec;
+		m_socket.non_blocking(true, ec);
+		if (ec)
+			co_return ec;
+		SSL_set_fd(m_ssl.get(), m_socket.native_handle());
+		if (type == boost::asio::ssl::stream_base::client)
+			SSL_set_connect_state(m_ssl.get());
+		else
+			SSL_set_accept_state(m_ssl.get());
+		for (;;) {
+			ERR_clear_error();
+			auto ret = SSL_do_handshake(m_ssl.get());
+			if (ret == 1)
+				co_return boost::system::error_code{};
+			if (auto ec_ = co_await wait(ret))
+				co_return ec_;
+		}
+	}
+
+	folly::coro::Task<std::pair<boost::system::error_code, size_t>> read_some(boost::asio::mutable_buffer buffer) {
+		for (;;) {
+			ERR_clear_error();
+			size_t length = 0;
+			auto ret = SSL_read_ex(m_ssl.get(), buffer.data(), buffer.size(), &length);
+			if (ret == 1)
+				co_return std::make_pair(boost::system::error_code{}, length);
+			if (auto ec = co_await wait(ret))
+				co_return std::make_pair(ec, size_t{0});
+		}
+	}
+
+	folly::coro::Task<std::pair<boost::system::error_code, size_t>> write(boost::asio::const_buffer buffer) {
+		size_t total = 0;
+		while (total < buffer.size()) {
+			ERR_clear_error();
+			size_t length = 0;
+			auto ret = SSL_write_ex(m_ssl.get(), static_cast<const char*>(buffer.data()) + total, buffer.size() - total, &length);
+			if (ret == 1) {
+				total += length;
+				continue;
+			}
+			if (auto ec = co_await wait(ret))
+				co_return std::make_pair(ec, total);
+		}
+		co_return std::make_pair(boost::system::error_code{}, total);
+	}
+
+	// zero copy file transmission, only available once the kernel owns the send side
+	folly::coro::Task<std::pair<boost::system::error_code, size_t>> sendfile(int fd, off_t offset, size_t size) {
+		size_t total = 0;
+#ifdef SSL_OP_ENABLE_KTLS
+		if (!ktlsSend())
+			co_return std::make_pair(boost::system::error_code{boost::asio::error::operation_not_supported}, total);
+		while (total < size) {
+			ERR_clear_error();
+			auto ret = SSL_sendfile(m_ssl.get(), fd, offset + total, size - total, 0);
+			if (ret > 0) {
+				total += ret;
+				continue;
+			}
+			if (auto ec = co_await wait(ret))
+				co_return std::make_pair(ec, total);
+		}
+		co_return std::make_pair(boost::system::error_code{}, total);
+#else
+		co_return std::make_pair(boost::system::error_code{boost::asio::error::operation_not_supported}, total);
+#endif
+	}
+
+	// sends close_notify without waiting for the peer's
+	void shutdown() {
+		ERR_clear_error();
+		SSL_shutdown(m_ssl.get());
+	}
+
+private:
+	folly::coro::Task<boost::system::error_code> wait(int ret) {
+		switch (SSL_get_error(m_ssl.get(), ret)) {
+		case SSL_ERROR_WANT_READ:
+			co_return co_await async_wait(m_socket, boost::asio::socket_base::wait_read);
+		case SSL_ERROR_WANT_WRITE:
+			co_return co_await async_wait(m_socket, boost::asio::socket_base::wait_write);
+		case SSL_ERROR_ZERO_RETURN:
+			co_return boost::system::error_code{boost::asio::error::eof};
+		case SSL_ERROR_SYSCALL:
+			if (errno == 0)
+				co_return boost::system::error_code{boost::asio::error::eof};
+			co_return boost::system::error_code{errno, boost::asio::error::get_system_category()};
+		default:
+			co_return boost::system::error_code{static_cast<int>(ERR_get_error()), boost::asio::error::get_ssl_category()};
+		}
+	}
+
+	boost::asio::ip::tcp::socket m_socket;
+	std::unique_ptr<SSL, decltype(&SSL_free)> m_ssl;
+};
+
+inline folly::coro::Task<boost::system::error_code> async_handshake(TlsSocket& socket, boost::asio::ssl::stream_base::handshake_type type) noexcept {
+	co_return co_await socket.handshake(type);
+}
+
+template <typename AsioBuffer>
+inline folly::coro::Task<std::pair<boost::system::error_code, size_t>> async_read_some(TlsSocket& socket, AsioBuffer&& buffer) noexcept {
+	co_return co_await socket.read_some(buffer);
+}
+
+template <typename AsioBuffer>
+inline folly::coro::Task<std::pair<boost::system::error_code, size_t>> async_write(TlsSocket& socket, AsioBuffer&& buffer) noexcept {
+	co_return co_await socket.write(buffer);
+}
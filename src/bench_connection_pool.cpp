@@ -0,0 +1,121 @@
+#include <io_context_pool.h>
+#include <asio_util.hpp>
+#include <connection_pool.h>
+#include <hdr_histogram.h>
+
+#include <future>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <folly/experimental/coro/BlockingWait.h>
+#include <folly/experimental/coro/Collect.h>
+
+struct Result {
+	std::string mode;
+	HdrHistogram latency{1, 60LL * 1000 * 1000 * 1000, 3};
+	int64_t requests{0};
+	int64_t errors{0};
+	uint64_t connects{0};
+	std::chrono::duration<double> elapsed{};
+};
+
+// one request-response on socket, the echo server returns the payload unchanged
+folly::coro::Task<bool> round_trip(boost::asio::ip::tcp::socket& socket, std::string& payload, std::vector<char>& reply) {
+	auto [write_ec, written] = co_await async_write(socket, boost::asio::buffer(payload));
+	if (write_ec)
+		co_return false;
+	auto buffer = boost::asio::buffer(reply.data(), payload.size());
+	auto [read_ec, length] = co_await async_read(socket, buffer);
+	co_return !read_ec;
+}
+
+folly::coro::Task<void> worker(boost::asio::io_context& io_context, ConnectionPool* pool, const std::string& host, const std::string& port,
+	std::string payload, std::chrono::steady_clock::time_point end, Result& result) {
+	std::vector<char> reply(payload.size());
+	while (std::chrono::steady_clock::now() < end) {
+		auto begin = std::chrono::steady_clock::now();
+		bool ok = false;
+		if (pool) {
+			auto [ec, connection] = co_await pool->acquire(host, port);
+			if (!ec) {
+				ok = co_await round_trip(connection->socket, payload, reply);
+				pool->release(std::move(connection), ok);
+			}
+		}
+		else {
+			boost::asio::ip::tcp::socket socket(io_context);
+			auto ec = co_await async_connect(io_context, socket, host, port);
+			if (!ec) {
+				result.connects++;
+				socket.set_option(boost::asio::ip::tcp::no_delay(true));
+				ok = co_await round_trip(socket, payload, reply);
+			}
+			boost::system::error_code ignore_ec;
+			socket.close(ignore_ec);
+		}
+		if (!ok) {
+			result.errors++;
+			continue;
+		}
+		result.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+		result.requests++;
+	}
+	co_return;
+}
+
+Result run(const std::string& mode, const std::string& host, const std::string& port, int32_t concurrency, size_t payload_size,
+	std::chrono::seconds duration) {
+	IoContextPool pool(1);
+	auto& context = pool.getIoContext();
+	pool.start();
+	Executor executor{context};
+	Result result;
+	result.mode = mode;
+	std::unique_ptr<ConnectionPool> connection_pool;
+	if (mode == "pooled")
+		connection_pool = std::make_unique<ConnectionPool>(context, ConnectionPoolConfig{.max_idle = static_cast<std::size_t>(concurrency)});
+	std::vector<folly::coro::TaskWithExecutor<void>> tasks;
+	auto begin = std::chrono::steady_clock::now();
+	for (int32_t i = 0; i < concurrency; ++i)
+		tasks.emplace_back(worker(context, connection_pool.get(), host, port, std::string(payload_size, 'x'), begin + duration, result)
+							   .scheduleOn(&executor));
+	folly::coro::blockingWait(folly::coro::collectAllRange(std::move(tasks)));
+	result.elapsed = std::chrono::steady_clock::now() - begin;
+	if (connection_pool) {
+		result.connects = connection_pool->connectCount();
+		// the pool owns timers and sockets of this context
+		std::promise<void> destroyed;
+		boost::asio::post(context, [&] {
+			connection_pool.reset();
+			destroyed.set_value();
+		});
+		destroyed.get_future().wait();
+	}
+	pool.stop();
+	return result;
+}
+
+// Runs against test_tcp_server, point it at a remote host to see the handshake RTT the pool saves.
+// ./bench_connection_pool [host] [port] [concurrency] [seconds per run] [payload bytes]
+int main(int argc, char** argv) {
+	try {
+		std::string host = argc > 1 ? argv[1] : "127.0.0.1";
+		std::string port = argc > 2 ? argv[2] : "8848";
+		int32_t concurrency = argc > 3 ? std::stoi(argv[3]) : 8;
+		std::chrono::seconds duration{argc > 4 ? std::stoi(argv[4]) : 5};
+		size_t payload_size = argc > 5 ? std::stoul(argv[5]) : 128;
+
+		fmt::print("{:<20}{:>12}{:>10}{:>10}{:>10}{:>10}{:>10}{:>10}\n", "mode", "req/s", "connects", "errors", "p50 us", "p99 us", "p99.9 us",
+			"max us");
+		for (auto mode : {"connect-per-request", "pooled"}) {
+			auto r = run(mode, host, port, concurrency, payload_size, duration);
+			auto us = [&](double percentile) { return r.latency.valueAtPercentile(percentile) / 1000.0; };
+			fmt::print("{:<20}{:>12.0f}{:>10}{:>10}{:>10.1f}{:>10.1f}{:>10.1f}{:>10.1f}\n", r.mode, r.requests / r.elapsed.count(), r.connects,
+				r.errors, us(50), us(99), us(99.9), r.latency.max() / 1000.0);
+		}
+	} catch (std::exception& e) {
+		spdlog::error("Exception: {}", e.what());
+	}
+	return 0;
+}
@@ -0,0 +1,608 @@
+#include <greeter_async_client.h>
+#include <greeter_async_server.h>
+#include <greeter_callback_server.h>
+#include <grpc_compression.h>
+#include <grpc_coro.h>
+#include <hdr_histogram.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <new>
+
+#include <linux/tcp.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/executors/InlineExecutor.h>
+
+// Every operator new of the process, client side included. gRPC core allocates with gpr_malloc and is not counted,
+// so this is the C++ layer: CallData, messages, reply strings, contexts.
+std::atomic<int64_t> g_allocations{0};
+
+void* operator new(std::size_t size) {
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (auto ptr = std::malloc(size == 0 ? 1 : size))
+		return ptr;
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+
+struct Result {
+	std::string name;
+	HdrHistogram latency{1, 60LL * 1000 * 1000 * 1000, 3};
+	int64_t calls{0};
+	int64_t errors{0};
+	int64_t allocations{0};
+	std::chrono::duration<double> elapsed{};
+};
+
+struct ClientCall {
+	grpc::ClientContext context;
+	HelloReply reply;
+	Status status;
+	std::unique_ptr<grpc::ClientAsyncResponseReader<HelloReply>> reader;
+	std::chrono::steady_clock::time_point start;
+};
+
+// A channel of its own per client thread, channels with equal arguments would share one subchannel and therefore
+// one tcp connection.
+std::shared_ptr<grpc::Channel> make_channel(const std::string& target, int32_t id) {
+	grpc::ChannelArguments args;
+	args.SetInt("bench.channel_id", id);
+	return grpc::CreateCustomChannel(target, grpc::InsecureChannelCredentials(), args);
+}
+
+// Closed loop: every client thread keeps depth SayHello calls outstanding on its own completion queue.
+Result run_load(const std::string& name, const std::string& target, int32_t client_threads, int32_t depth, std::chrono::seconds duration) {
+	Result result;
+	result.name = name;
+	std::mutex mutex;
+	std::vector<std::thread> threads;
+	auto allocations = g_allocations.load();
+	auto begin = std::chrono::steady_clock::now();
+	auto end = begin + duration;
+	for (int32_t i = 0; i < client_threads; ++i) {
+		threads.emplace_back([&, i] {
+			auto stub = Greeter::NewStub(make_channel(target, i));
+			grpc::CompletionQueue cq;
+			HelloRequest request;
+			request.set_name("world");
+			Result local;
+			auto start_call = [&] {
+				auto call = new ClientCall;
+				call->start = std::chrono::steady_clock::now();
+				call->reader = stub->AsyncSayHello(&call->context, request, &cq);
+				call->reader->Finish(&call->reply, &call->status, call);
+			};
+			for (int32_t j = 0; j < depth; ++j)
+				start_call();
+			int32_t outstanding = depth;
+			void* tag;
+			bool ok;
+			while (outstanding > 0 && cq.Next(&tag, &ok)) {
+				std::unique_ptr<ClientCall> call{static_cast<ClientCall*>(tag)};
+				auto now = std::chrono::steady_clock::now();
+				outstanding--;
+				if (ok && call->status.ok()) {
+					local.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - call->start).count());
+					local.calls++;
+				}
+				else {
+					local.errors++;
+				}
+				if (now < end) {
+					start_call();
+					outstanding++;
+				}
+			}
+			cq.Shutdown();
+			while (cq.Next(&tag, &ok))
+				;
+			std::lock_guard<std::mutex> lk(mutex);
+			result.latency.merge(local.latency);
+			result.calls += local.calls;
+			result.errors += local.errors;
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+	result.elapsed = std::chrono::steady_clock::now() - begin;
+	result.allocations = g_allocations.load() - allocations;
+	return result;
+}
+
+void print_table(const std::vector<Result>& results) {
+	fmt::print("{:<28}{:>12}{:>10}{:>13}{:>10}{:>10}{:>10}{:>10}\n", "run", "calls/s", "errors", "allocs/call", "p50 us", "p99 us", "p99.9 us",
+		"max us");
+	for (auto& r : results) {
+		auto us = [&](double percentile) { return r.latency.valueAtPercentile(percentile) / 1000.0; };
+		fmt::print("{:<28}{:>12.0f}{:>10}{:>13.1f}{:>10.1f}{:>10.1f}{:>10.1f}{:>10.1f}\n", r.name, r.calls / r.elapsed.count(), r.errors,
+			r.calls ? static_cast<double>(r.allocations) / r.calls : 0.0, us(50), us(99), us(99.9), r.latency.max() / 1000.0);
+	}
+}
+
+// SayHello throughput of ServerImpl as the number of completion queues (one pinned polling thread each) grows.
+std::vector<Result> bench_cq_scaling(int32_t max_cqs, int32_t client_threads, int32_t depth, std::chrono::seconds duration) {
+	std::vector<Result> results;
+	std::vector<int32_t> cpus;
+	for (int32_t cpu = 0; cpu < static_cast<int32_t>(std::thread::hardware_concurrency()); ++cpu)
+		cpus.emplace_back(cpu);
+	for (int32_t cqs = 1; cqs <= max_cqs; cqs *= 2) {
+		ServerImpl server("127.0.0.1:0", cqs, cpus);
+		server.Start();
+		results.emplace_back(run_load(fmt::format("cq-scaling cqs={}", cqs), fmt::format("127.0.0.1:{}", server.Port()), client_threads, depth, duration));
+		spdlog::info("finished {}", results.back().name);
+	}
+	return results;
+}
+
+// Idle server, then burst_size calls at once, repeated: latency of calls arriving together, as a function of how many
+// RequestSayHello slots each completion queue keeps armed.
+std::vector<Result> bench_burst(int32_t burst_size, int32_t bursts, std::chrono::milliseconds gap) {
+	std::vector<Result> results;
+	for (int32_t slots : {1, 16, 64, 256}) {
+		ServerImpl server("127.0.0.1:0", 1, {}, slots);
+		server.Start();
+		Result result;
+		result.name = fmt::format("burst={} slots={}", burst_size, slots);
+		auto stub = Greeter::NewStub(make_channel(fmt::format("127.0.0.1:{}", server.Port()), 0));
+		grpc::CompletionQueue cq;
+		HelloRequest request;
+		request.set_name("world");
+		auto allocations = g_allocations.load();
+		auto begin = std::chrono::steady_clock::now();
+		std::chrono::steady_clock::duration busy{};
+		for (int32_t burst = 0; burst < bursts; ++burst) {
+			std::this_thread::sleep_for(gap);
+			auto burst_begin = std::chrono::steady_clock::now();
+			for (int32_t i = 0; i < burst_size; ++i) {
+				auto call = new ClientCall;
+				call->start = burst_begin;
+				call->reader = stub->AsyncSayHello(&call->context, request, &cq);
+				call->reader->Finish(&call->reply, &call->status, call);
+			}
+			void* tag;
+			bool ok;
+			for (int32_t i = 0; i < burst_size && cq.Next(&tag, &ok); ++i) {
+				std::unique_ptr<ClientCall> call{static_cast<ClientCall*>(tag)};
+				if (ok && call->status.ok()) {
+					result.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - call->start).count());
+					result.calls++;
+				}
+				else {
+					result.errors++;
+				}
+			}
+			busy += std::chrono::steady_clock::now() - burst_begin;
+		}
+		// throughput while a burst is being served, the idle gaps left out
+		result.elapsed = busy;
+		result.allocations = g_allocations.load() - allocations;
+		cq.Shutdown();
+		void* tag;
+		bool ok;
+		while (cq.Next(&tag, &ok))
+			;
+		results.emplace_back(std::move(result));
+		spdlog::info("finished {} in {:.1f}s", results.back().name, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+	}
+	return results;
+}
+
+// in_flight SayHello kept outstanding through the callbacks of client.
+Result run_async_client(const std::string& name, GreeterClient& client, int32_t in_flight, std::chrono::seconds duration,
+	const std::string& user = "world") {
+	Result result;
+	result.name = name;
+	std::mutex mutex;
+	std::condition_variable cv;
+	int32_t outstanding = 0;
+	auto allocations = g_allocations.load();
+	auto begin = std::chrono::steady_clock::now();
+	std::function<void()> start_call = [&] {
+		auto start = std::chrono::steady_clock::now();
+		client.AsyncSayHello(user, [&, start](const Status& status, HelloReply&) {
+			auto now = std::chrono::steady_clock::now();
+			std::lock_guard<std::mutex> lk(mutex);
+			if (status.ok()) {
+				result.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count());
+				result.calls++;
+			}
+			else {
+				result.errors++;
+			}
+			if (now < begin + duration) {
+				start_call();
+				return;
+			}
+			if (--outstanding == 0)
+				cv.notify_one();
+		});
+	};
+	{
+		std::lock_guard<std::mutex> lk(mutex);
+		outstanding = in_flight;
+	}
+	for (int32_t i = 0; i < in_flight; ++i)
+		start_call();
+	std::unique_lock<std::mutex> lk(mutex);
+	cv.wait(lk, [&] { return outstanding == 0; });
+	result.elapsed = std::chrono::steady_clock::now() - begin;
+	result.allocations = g_allocations.load() - allocations;
+	return result;
+}
+
+// GreeterClient from client threads blocking in SayHello, one call in flight each, against in_flight calls kept
+// outstanding through the shared completion queues.
+std::vector<Result> bench_client(int32_t client_threads, int32_t in_flight, std::chrono::seconds duration) {
+	std::vector<Result> results;
+	ServerImpl server("127.0.0.1:0", static_cast<int32_t>(std::thread::hardware_concurrency()));
+	server.Start();
+	auto target = fmt::format("127.0.0.1:{}", server.Port());
+	{
+		GreeterClient client(make_channel(target, 0));
+		Result result;
+		result.name = fmt::format("client blocking threads={}", client_threads);
+		std::mutex mutex;
+		std::vector<std::thread> threads;
+		auto allocations = g_allocations.load();
+		auto begin = std::chrono::steady_clock::now();
+		for (int32_t i = 0; i < client_threads; ++i) {
+			threads.emplace_back([&] {
+				Result local;
+				while (std::chrono::steady_clock::now() < begin + duration) {
+					auto start = std::chrono::steady_clock::now();
+					auto [status, message] = client.AsyncSayHello("world").get();
+					if (!status.ok()) {
+						local.errors++;
+						continue;
+					}
+					local.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+					local.calls++;
+				}
+				std::lock_guard<std::mutex> lk(mutex);
+				result.latency.merge(local.latency);
+				result.calls += local.calls;
+				result.errors += local.errors;
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+		result.elapsed = std::chrono::steady_clock::now() - begin;
+		result.allocations = g_allocations.load() - allocations;
+		results.emplace_back(std::move(result));
+	}
+	{
+		GreeterClient client(make_channel(target, 1), 2);
+		results.emplace_back(run_async_client(fmt::format("client async in_flight={}", in_flight), client, in_flight, duration));
+	}
+	for (auto& r : results)
+		spdlog::info("finished {}", r.name);
+	return results;
+}
+
+folly::coro::Task<grpc::Status> say_hello(grpc::ServerContext&, const HelloRequest& request, HelloReply& reply) {
+	reply.set_message("Hello " + request.name());
+	co_return grpc::Status::OK;
+}
+
+// Coroutine client: in_flight coroutines calling async_say_hello in a loop on the queues of one GreeterClient.
+folly::coro::Task<void> coro_caller(GreeterClient& client, std::chrono::steady_clock::time_point end, Result& result, std::mutex& mutex) {
+	HelloRequest request;
+	request.set_name("world");
+	while (std::chrono::steady_clock::now() < end) {
+		auto start = std::chrono::steady_clock::now();
+		auto [status, reply] = co_await async_say_hello(client, request);
+		auto now = std::chrono::steady_clock::now();
+		std::lock_guard<std::mutex> lk(mutex);
+		if (!status.ok()) {
+			result.errors++;
+			continue;
+		}
+		result.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count());
+		result.calls++;
+	}
+	co_return;
+}
+
+// The tag state machine of ServerImpl against CoroGreeterServer under the same load, with the handler resumed
+// inline on the polling thread and hopping to a thread pool, then the coroutine client.
+std::vector<Result> bench_coro(int32_t client_threads, int32_t depth, std::chrono::seconds duration) {
+	std::vector<Result> results;
+	{
+		ServerImpl server("127.0.0.1:0");
+		server.Start();
+		results.emplace_back(run_load("state machine server", fmt::format("127.0.0.1:{}", server.Port()), client_threads, depth, duration));
+	}
+	folly::InlineExecutor inline_executor;
+	{
+		CoroGreeterServer server(say_hello, &inline_executor, "127.0.0.1:0");
+		server.start();
+		results.emplace_back(run_load("coro server inline", fmt::format("127.0.0.1:{}", server.port()), client_threads, depth, duration));
+	}
+	{
+		folly::CPUThreadPoolExecutor pool(2);
+		CoroGreeterServer server(say_hello, &pool, "127.0.0.1:0");
+		server.start();
+		results.emplace_back(run_load("coro server pool=2", fmt::format("127.0.0.1:{}", server.port()), client_threads, depth, duration));
+	}
+	ServerImpl server("127.0.0.1:0");
+	server.Start();
+	GreeterClient client(make_channel(fmt::format("127.0.0.1:{}", server.Port()), 0));
+	Result result;
+	result.name = fmt::format("coro client in_flight={}", client_threads * depth);
+	std::mutex mutex;
+	auto allocations = g_allocations.load();
+	auto begin = std::chrono::steady_clock::now();
+	std::vector<folly::SemiFuture<folly::Unit>> callers;
+	for (int32_t i = 0; i < client_threads * depth; ++i)
+		callers.emplace_back(coro_caller(client, begin + duration, result, mutex).scheduleOn(&inline_executor).start());
+	for (auto& caller : callers)
+		std::move(caller).get();
+	result.elapsed = std::chrono::steady_clock::now() - begin;
+	result.allocations = g_allocations.load() - allocations;
+	results.emplace_back(std::move(result));
+	for (auto& r : results)
+		spdlog::info("finished {}", r.name);
+	return results;
+}
+
+// ServerImpl against CallbackServerImpl under the same closed loop load, at the given depth and at depth 1 where
+// latency rather than throughput is what counts. Both servers get every core: ServerImpl one completion queue per
+// core, the callback server sizes its own pool.
+std::vector<Result> bench_callback(int32_t client_threads, int32_t depth, std::chrono::seconds duration) {
+	std::vector<Result> results;
+	auto cqs = static_cast<int32_t>(std::thread::hardware_concurrency());
+	for (int32_t d : {depth, 1}) {
+		{
+			ServerImpl server("127.0.0.1:0", cqs);
+			server.Start();
+			results.emplace_back(run_load(fmt::format("cq server depth={}", d), fmt::format("127.0.0.1:{}", server.Port()), client_threads, d, duration));
+		}
+		{
+			CallbackServerImpl server("127.0.0.1:0");
+			server.Start();
+			results.emplace_back(run_load(fmt::format("callback server depth={}", d), fmt::format("127.0.0.1:{}", server.Port()), client_threads, d, duration));
+		}
+	}
+	for (auto& r : results)
+		spdlog::info("finished {}", r.name);
+	return results;
+}
+
+// One GreeterClient spreading in_flight calls over a pool of 1 to max_channels connections, one completion queue per
+// channel, round robin and least loaded at the largest size.
+std::vector<Result> bench_channel_pool(int32_t max_channels, int32_t in_flight, std::chrono::seconds duration) {
+	std::vector<Result> results;
+	ServerImpl server("127.0.0.1:0", static_cast<int32_t>(std::thread::hardware_concurrency()));
+	server.Start();
+	auto target = fmt::format("127.0.0.1:{}", server.Port());
+	for (int32_t channels = 1; channels <= max_channels; channels *= 2) {
+		GreeterClient client(CreateChannelPool(target, channels), channels);
+		results.emplace_back(run_async_client(fmt::format("pool channels={} rr", channels), client, in_flight, duration));
+		spdlog::info("finished {}", results.back().name);
+	}
+	GreeterClient client(CreateChannelPool(target, max_channels), max_channels, GreeterClient::ChannelSelection::kLeastLoaded);
+	results.emplace_back(run_async_client(fmt::format("pool channels={} least", max_channels), client, in_flight, duration));
+	spdlog::info("finished {}", results.back().name);
+	return results;
+}
+
+// TCP payload bytes received by every socket of the process. Client and server both live here, so every byte on the
+// wire is counted exactly once, headers and framing included.
+int64_t tcp_bytes_received() {
+	int64_t total = 0;
+	for (const auto& entry : std::filesystem::directory_iterator("/proc/self/fd")) {
+		tcp_info info{};
+		socklen_t length = sizeof(info);
+		if (getsockopt(std::stoi(entry.path().filename().string()), IPPROTO_TCP, TCP_INFO, &info, &length) == 0)
+			total += static_cast<int64_t>(info.tcpi_bytes_received);
+	}
+	return total;
+}
+
+std::chrono::microseconds cpu_time() {
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	auto us = [](const timeval& tv) { return std::chrono::seconds(tv.tv_sec) + std::chrono::microseconds(tv.tv_usec); };
+	return us(usage.ru_utime) + us(usage.ru_stime);
+}
+
+// Text that compresses like real payloads do rather than like a run of one byte.
+std::string make_payload(size_t size) {
+	static const std::vector<std::string> words{"alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel", "india",
+		"juliett", "kilo", "lima", "mike", "november", "oscar", "papa", "quebec", "romeo", "sierra", "tango"};
+	std::string payload;
+	uint32_t state = 12345;
+	while (payload.size() < size) {
+		state = state * 1103515245 + 12345;
+		payload += words[(state >> 16) % words.size()];
+		payload += fmt::format("{} ", (state >> 8) % 1000);
+	}
+	payload.resize(size);
+	return payload;
+}
+
+// Bytes on the wire and process CPU (client and server together) per SayHello across payload sizes, uncompressed,
+// gzip above a 1 KiB threshold and gzip on everything.
+void bench_compression(int32_t in_flight, std::chrono::seconds duration) {
+	struct Mode {
+		std::string name;
+		size_t min_bytes;
+	};
+	fmt::print("{:>10}{:>14}{:>12}{:>16}{:>16}\n", "payload", "compression", "calls/s", "wire B/call", "cpu us/call");
+	for (size_t payload_size : {64, 256, 1024, 4096, 16384, 65536}) {
+		auto payload = make_payload(payload_size);
+		for (const auto& mode : {Mode{"off", 0}, Mode{"gzip>=1KiB", 1024}, Mode{"gzip all", 1}}) {
+			CompressionOptions options;
+			options.min_bytes = mode.min_bytes;
+			ServerImpl server("127.0.0.1:0");
+			server.set_compression_options(options);
+			server.Start();
+			GreeterClient client(make_channel(fmt::format("127.0.0.1:{}", server.Port()), 0));
+			client.set_compression_options(options);
+			// connect outside the measurement
+			client.SayHello("warmup");
+			auto bytes = tcp_bytes_received();
+			auto cpu = cpu_time();
+			auto result = run_async_client("compression", client, in_flight, duration, payload);
+			auto calls = std::max<int64_t>(result.calls, 1);
+			fmt::print("{:>10}{:>14}{:>12.0f}{:>16.0f}{:>16.1f}\n", payload_size, mode.name, result.calls / result.elapsed.count(),
+				static_cast<double>(tcp_bytes_received() - bytes) / calls, static_cast<double>((cpu_time() - cpu).count()) / calls);
+		}
+	}
+}
+
+struct StreamResult {
+	std::string name;
+	int64_t names{0};
+	int64_t messages{0};
+	int64_t errors{0};
+	std::chrono::duration<double> elapsed{};
+};
+
+// client_threads each run one call after another through a shared GreeterClient, call(client, result) blocks until
+// its call is done and adds what it greeted.
+StreamResult run_stream(const std::string& name, GreeterClient& client, int32_t client_threads, std::chrono::seconds duration,
+	const std::function<void(GreeterClient&, StreamResult&)>& call) {
+	StreamResult result;
+	result.name = name;
+	std::mutex mutex;
+	std::vector<std::thread> threads;
+	auto begin = std::chrono::steady_clock::now();
+	for (int32_t i = 0; i < client_threads; ++i) {
+		threads.emplace_back([&] {
+			StreamResult local;
+			while (std::chrono::steady_clock::now() < begin + duration)
+				call(client, local);
+			std::lock_guard<std::mutex> lk(mutex);
+			result.names += local.names;
+			result.messages += local.messages;
+			result.errors += local.errors;
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+	result.elapsed = std::chrono::steady_clock::now() - begin;
+	return result;
+}
+
+// Names greeted per second by unary SayHello against the batched streaming variants, messages counts the protobuf
+// messages on the wire in both directions.
+std::vector<StreamResult> bench_streaming(int32_t client_threads, int32_t depth, std::chrono::seconds duration) {
+	std::vector<StreamResult> results;
+	ServerImpl server("127.0.0.1:0");
+	server.Start();
+	auto target = fmt::format("127.0.0.1:{}", server.Port());
+	auto unary = run_load(fmt::format("unary depth={}", depth), target, client_threads, depth, duration);
+	results.emplace_back(StreamResult{unary.name, unary.calls, unary.calls * 2, unary.errors, unary.elapsed});
+	GreeterClient client(make_channel(target, 0), 2);
+	constexpr int32_t kNamesPerCall = 10000;
+	for (int32_t batch : {10, 100, 1000}) {
+		HelloBatchRequest request;
+		for (int32_t i = 0; i < kNamesPerCall; ++i)
+			request.add_names("world");
+		request.set_reply_batch_size(batch);
+		results.emplace_back(run_stream(fmt::format("server stream batch={}", batch), client, client_threads, duration,
+			[&](GreeterClient& client, StreamResult& result) {
+				std::promise<Status> done;
+				int64_t names = 0;
+				int64_t messages = 1;
+				client.AsyncSayHelloStream(
+					request,
+					[&](HelloBatchReply& reply) {
+						names += reply.messages_size();
+						messages++;
+					},
+					[&](const Status& status) { done.set_value(status); });
+				if (!done.get_future().get().ok()) {
+					result.errors++;
+					return;
+				}
+				result.names += names;
+				result.messages += messages;
+			}));
+		spdlog::info("finished {}", results.back().name);
+	}
+	for (int32_t batch : {10, 100, 1000}) {
+		std::vector<HelloBatchRequest> batches(kNamesPerCall / batch);
+		for (auto& request : batches) {
+			for (int32_t i = 0; i < batch; ++i)
+				request.add_names("world");
+		}
+		results.emplace_back(run_stream(fmt::format("bidi batch={} window=8", batch), client, client_threads, duration,
+			[&](GreeterClient& client, StreamResult& result) {
+				std::promise<Status> done;
+				int64_t names = 0;
+				int64_t messages = static_cast<int64_t>(batches.size());
+				client.AsyncSayHelloBidi(
+					batches, 8,
+					[&](HelloBatchReply& reply) {
+						names += reply.messages_size();
+						messages++;
+					},
+					[&](const Status& status) { done.set_value(status); });
+				if (!done.get_future().get().ok()) {
+					result.errors++;
+					return;
+				}
+				result.names += names;
+				result.messages += messages;
+			}));
+		spdlog::info("finished {}", results.back().name);
+	}
+	return results;
+}
+
+void print_stream_table(const std::vector<StreamResult>& results) {
+	fmt::print("{:<28}{:>14}{:>14}{:>10}\n", "run", "names/s", "messages/s", "errors");
+	for (auto& r : results)
+		fmt::print("{:<28}{:>14.0f}{:>14.0f}{:>10}\n", r.name, r.names / r.elapsed.count(), r.messages / r.elapsed.count(), r.errors);
+}
+
+// ./bench_grpc [max completion queues] [client threads] [calls in flight per client thread] [seconds per run]
+int main(int argc, char** argv) {
+	try {
+		int32_t max_cqs = argc > 1 ? std::stoi(argv[1]) : static_cast<int32_t>(std::thread::hardware_concurrency());
+		int32_t client_threads = argc > 2 ? std::stoi(argv[2]) : 4;
+		int32_t depth = argc > 3 ? std::stoi(argv[3]) : 32;
+		std::chrono::seconds duration{argc > 4 ? std::stoi(argv[4]) : 5};
+
+		std::vector<Result> results;
+		for (auto& r : bench_cq_scaling(max_cqs, client_threads, depth, duration))
+			results.emplace_back(std::move(r));
+		for (auto& r : bench_callback(client_threads, depth, duration))
+			results.emplace_back(std::move(r));
+		for (auto& r : bench_coro(client_threads, depth, duration))
+			results.emplace_back(std::move(r));
+		for (auto& r : bench_client(client_threads, 1024, duration))
+			results.emplace_back(std::move(r));
+		for (auto& r : bench_channel_pool(max_cqs, 1024, duration))
+			results.emplace_back(std::move(r));
+		for (auto& r : bench_burst(256, static_cast<int32_t>(duration.count()) * 20, std::chrono::milliseconds(50)))
+			results.emplace_back(std::move(r));
+		print_table(results);
+		print_stream_table(bench_streaming(client_threads, depth, duration));
+		bench_compression(32, duration);
+	} catch (std::exception& e) {
+		spdlog::error("Exception: {}", e.what());
+	}
+	return 0;
+}
@@ -0,0 +1,179 @@
+#include <greeter_async_client.h>
+#include <greeter_server_factory.h>
+#include <hdr_histogram.h>
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <nlohmann/json.hpp>
+
+struct LoadOptions {
+	// host:port of a running server, empty to start one in process
+	std::string target;
+	// "cq" or "callback", for the server started in process
+	std::string server;
+	// calls outstanding at most
+	int32_t concurrency;
+	// calls per second, 0 for a closed loop that keeps concurrency calls outstanding
+	double qps;
+	std::chrono::seconds duration;
+	// bytes of the name in every HelloRequest
+	int32_t payload;
+	// completion queue threads of the client, and of the server started in process
+	int32_t cq_threads;
+	int32_t channels;
+	std::string output;
+};
+
+struct LoadStats {
+	// nanoseconds, from the intended send time when qps is set
+	HdrHistogram latency{1, 3600LL * 1000 * 1000 * 1000, 3};
+	int64_t sent{0};
+	int64_t received{0};
+	int64_t errors{0};
+};
+
+// Open loop when options.qps is set: call n is due at start + n / qps and its latency counts from then, so a stalled
+// server shows in the percentiles instead of slowing the schedule down. Closed loop otherwise.
+LoadStats run_load(const LoadOptions& options, GreeterClient& client, std::chrono::steady_clock::time_point start) {
+	LoadStats stats;
+	std::mutex mutex;
+	std::condition_variable cv;
+	int32_t outstanding = 0;
+	auto end = start + options.duration;
+	std::string user(options.payload, 'x');
+	auto send = [&](std::chrono::steady_clock::time_point intended) {
+		client.AsyncSayHello(user, [&, intended](const Status& status, HelloReply&) {
+			auto now = std::chrono::steady_clock::now();
+			std::lock_guard<std::mutex> lk(mutex);
+			if (status.ok()) {
+				stats.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - intended).count());
+				stats.received++;
+			}
+			else {
+				stats.errors++;
+			}
+			outstanding--;
+			cv.notify_one();
+		});
+	};
+	std::unique_lock<std::mutex> lk(mutex);
+	auto interval = options.qps > 0 ? std::chrono::duration<double>(1.0 / options.qps) : std::chrono::duration<double>::zero();
+	for (int64_t n = 0;; ++n) {
+		auto intended = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval * n);
+		if (intended >= end)
+			break;
+		// completions keep coming in while the pacer sleeps
+		if (options.qps > 0)
+			cv.wait_until(lk, intended, [] { return false; });
+		// at the concurrency limit the call waits for a slot, its latency still counts from when it was due
+		cv.wait(lk, [&] { return outstanding < options.concurrency; });
+		auto now = std::chrono::steady_clock::now();
+		if (now >= end)
+			break;
+		if (options.qps <= 0)
+			intended = now;
+		outstanding++;
+		stats.sent++;
+		lk.unlock();
+		send(intended);
+		lk.lock();
+	}
+	cv.wait(lk, [&] { return outstanding == 0; });
+	return stats;
+}
+
+nlohmann::json report(const LoadOptions& options, const LoadStats& stats, std::chrono::duration<double> elapsed) {
+	auto us = [&](double percentile) { return stats.latency.valueAtPercentile(percentile) / 1000.0; };
+	nlohmann::json j;
+	j["target"] = options.target.empty() ? "local " + options.server : options.target;
+	j["concurrency"] = options.concurrency;
+	j["target_qps"] = options.qps;
+	j["payload_bytes"] = options.payload;
+	j["cq_threads"] = options.cq_threads;
+	j["channels"] = options.channels;
+	j["duration_s"] = elapsed.count();
+	j["sent"] = stats.sent;
+	j["received"] = stats.received;
+	j["errors"] = stats.errors;
+	j["throughput_qps"] = stats.received / elapsed.count();
+	j["latency_us"] = {
+		{"min", stats.latency.min() / 1000.0},
+		{"mean", stats.latency.mean() / 1000.0},
+		{"p50", us(50)},
+		{"p90", us(90)},
+		{"p99", us(99)},
+		{"p99.9", us(99.9)},
+		{"max", stats.latency.max() / 1000.0},
+	};
+	return j;
+}
+
+// ./bench_grpc_load --concurrency 256 --qps 50000 --duration 30 --payload 1024 --cq-threads 4 --channels 4
+int main(int argc, char** argv) {
+	try {
+		LoadOptions options;
+		int64_t duration = 0;
+		boost::program_options::options_description desc("grpc SayHello load generator");
+		desc.add_options()("help", "print help")
+			("target", boost::program_options::value(&options.target), "host:port of a running server, default starts one in process")
+			("server", boost::program_options::value(&options.server)->default_value("cq"), "cq | callback, the server started in process")
+			("concurrency", boost::program_options::value(&options.concurrency)->default_value(64), "calls outstanding at most")
+			("qps", boost::program_options::value(&options.qps)->default_value(0), "target calls per second, 0 for a closed loop")
+			("duration", boost::program_options::value(&duration)->default_value(10), "seconds")
+			("payload", boost::program_options::value(&options.payload)->default_value(16), "request bytes")
+			("cq-threads", boost::program_options::value(&options.cq_threads)->default_value(2), "completion queue threads, client and server")
+			("channels", boost::program_options::value(&options.channels)->default_value(1), "channels, one connection each")
+			("output", boost::program_options::value(&options.output), "write the json report to this file instead of stdout");
+		boost::program_options::variables_map vm;
+		boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), vm);
+		boost::program_options::notify(vm);
+		if (vm.count("help")) {
+			std::cout << desc << std::endl;
+			return 0;
+		}
+		options.duration = std::chrono::seconds(duration);
+		if (options.concurrency <= 0 || options.qps < 0 || options.payload < 0 || options.cq_threads <= 0 || options.channels <= 0)
+			throw std::invalid_argument("invalid concurrency, qps, payload, cq-threads or channels");
+
+		std::unique_ptr<GreeterServer> server;
+		auto target = options.target;
+		if (target.empty()) {
+			server = MakeGreeterServer(ParseGreeterServerMode(options.server), "127.0.0.1:0", options.cq_threads);
+			server->Start();
+			target = fmt::format("127.0.0.1:{}", server->Port());
+		}
+		nlohmann::json j;
+		{
+			GreeterClient client(CreateChannelPool(target, options.channels), options.cq_threads);
+			// connect every channel before the schedule starts
+			for (int32_t i = 0; i < options.channels; ++i)
+				client.SayHello("warmup");
+			auto start = std::chrono::steady_clock::now();
+			auto stats = run_load(options, client, start);
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			j = report(options, stats, elapsed);
+		}
+		if (server) {
+			server->Shutdown();
+			server->Wait();
+		}
+
+		if (options.output.empty()) {
+			std::cout << j.dump(4) << std::endl;
+		}
+		else {
+			std::ofstream out(options.output);
+			out << j.dump(4) << std::endl;
+		}
+	} catch (std::exception& e) {
+		spdlog::error("Exception: {}", e.what());
+	}
+	return 0;
+}
@@ -0,0 +1,88 @@
+#include <io_context_pool.h>
+#include <asio_util.hpp>
+#include <hdr_histogram.h>
+#include <multiplex_channel.h>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <folly/experimental/coro/BlockingWait.h>
+#include <folly/experimental/coro/Collect.h>
+
+struct Result {
+	int32_t in_flight;
+	HdrHistogram latency{1, 60LL * 1000 * 1000 * 1000, 3};
+	int64_t requests{0};
+	int64_t bytes{0};
+	int64_t errors{0};
+	std::chrono::duration<double> elapsed{};
+};
+
+folly::coro::Task<void> caller(MultiplexChannel& channel, std::string payload, std::chrono::steady_clock::time_point end, Result& result) {
+	while (std::chrono::steady_clock::now() < end) {
+		auto begin = std::chrono::steady_clock::now();
+		auto [ec, reply] = co_await channel.call(payload);
+		if (ec) {
+			result.errors++;
+			break;
+		}
+		result.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+		result.requests++;
+		result.bytes += reply.size();
+	}
+	co_return;
+}
+
+folly::coro::Task<void> callers(MultiplexChannel& channel, int32_t in_flight, size_t payload_size, std::chrono::seconds duration, Result& result) {
+	std::vector<folly::coro::Task<void>> tasks;
+	auto begin = std::chrono::steady_clock::now();
+	for (int32_t i = 0; i < in_flight; ++i)
+		tasks.emplace_back(caller(channel, std::string(payload_size, 'x'), begin + duration, result));
+	co_await folly::coro::collectAllRange(std::move(tasks));
+	result.elapsed = std::chrono::steady_clock::now() - begin;
+	channel.close();
+	co_return;
+}
+
+folly::coro::Task<void> run(boost::asio::io_context& io_context, const std::string& host, const std::string& port, size_t payload_size,
+	std::chrono::seconds duration, Result& result) {
+	boost::asio::ip::tcp::socket socket(io_context);
+	if (auto ec = co_await async_connect(io_context, socket, host, port)) {
+		spdlog::error("Connect error: {}", ec.message());
+		result.errors++;
+		co_return;
+	}
+	socket.set_option(boost::asio::ip::tcp::no_delay(true));
+	MultiplexChannel channel(std::move(socket));
+	co_await folly::coro::collectAll(channel.run(), callers(channel, result.in_flight, payload_size, duration, result));
+	co_return;
+}
+
+// Requests in flight on a single connection to test_tcp_server, 1 is the old wait-for-each-reply client.
+// ./bench_multiplex [host] [port] [seconds per run] [payload bytes]
+int main(int argc, char** argv) {
+	try {
+		std::string host = argc > 1 ? argv[1] : "127.0.0.1";
+		std::string port = argc > 2 ? argv[2] : "8848";
+		std::chrono::seconds duration{argc > 3 ? std::stoi(argv[3]) : 5};
+		size_t payload_size = argc > 4 ? std::stoul(argv[4]) : 128;
+
+		IoContextPool pool(1);
+		auto& context = pool.getIoContext();
+		pool.start();
+		Executor executor{context};
+		fmt::print("{:>10}{:>12}{:>10}{:>10}{:>10}{:>10}{:>10}\n", "in flight", "req/s", "MiB/s", "errors", "p50 us", "p99 us", "max us");
+		for (int32_t in_flight : {1, 4, 16, 64, 256}) {
+			Result r{in_flight};
+			folly::coro::blockingWait(run(context, host, port, payload_size, duration, r).scheduleOn(&executor));
+			auto seconds = r.elapsed.count();
+			auto us = [&](double percentile) { return r.latency.valueAtPercentile(percentile) / 1000.0; };
+			fmt::print("{:>10}{:>12.0f}{:>10.1f}{:>10}{:>10.1f}{:>10.1f}{:>10.1f}\n", in_flight, r.requests / seconds, r.bytes / seconds / (1024 * 1024),
+				r.errors, us(50), us(99), r.latency.max() / 1000.0);
+		}
+		pool.stop();
+	} catch (std::exception& e) {
+		spdlog::error("Exception: {}", e.what());
+	}
+	return 0;
+}
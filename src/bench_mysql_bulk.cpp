@@ -0,0 +1,121 @@
+#include <io_context_pool.h>
+#include <mysql_bulk_writer.h>
+#include <mysql_pool.h>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <folly/experimental/coro/BlockingWait.h>
+#include <folly/experimental/coro/Collect.h>
+
+struct Result {
+	std::string mode;
+	uint64_t rows{0};
+	uint64_t batches{0};
+	std::size_t final_batch_rows{0};
+	std::chrono::duration<double> elapsed{};
+};
+
+folly::coro::Task<void> reset_table(MysqlHandle& conn) {
+	for (auto sql : {"DROP TABLE IF EXISTS bench_bulk", "CREATE TABLE bench_bulk(id BIGINT NOT NULL PRIMARY KEY, name VARCHAR(32), payload VARCHAR(128))"}) {
+		auto [ec, ei, _] = co_await async_query(*conn, sql);
+		if (ec)
+			throw std::runtime_error(fmt::format("{}: {}-{}", sql, ec.message(), ei.message()));
+	}
+}
+
+MysqlBulkRow make_row(int64_t id) {
+	return {id, fmt::format("name-{}", id), std::string(100, 'x')};
+}
+
+// the way test_boost_mysql inserts: one execute of a one row statement per row
+folly::coro::Task<Result> run_single(MysqlSubPool& pool, int64_t rows) {
+	Result result;
+	result.mode = "row at a time";
+	auto [ec, conn] = co_await pool.acquire();
+	if (ec)
+		throw std::runtime_error("acquire: " + ec.message());
+	co_await reset_table(conn);
+	auto begin = std::chrono::steady_clock::now();
+	for (int64_t id = 0; id < rows; ++id) {
+		auto row = make_row(id);
+		std::vector<boost::mysql::value> params{boost::mysql::value{std::get<int64_t>(row[0])},
+			boost::mysql::value{std::string_view{std::get<std::string>(row[1])}}, boost::mysql::value{std::string_view{std::get<std::string>(row[2])}}};
+		auto [execute_ec, ei, _] = co_await async_execute(conn, "INSERT INTO bench_bulk (id, name, payload) VALUES (?, ?, ?)", std::move(params));
+		if (execute_ec)
+			throw std::runtime_error(fmt::format("insert: {}-{}", execute_ec.message(), ei.message()));
+		result.batches++;
+	}
+	result.elapsed = std::chrono::steady_clock::now() - begin;
+	result.rows = rows;
+	result.final_batch_rows = 1;
+	co_return result;
+}
+
+folly::coro::Task<Result> run_bulk(MysqlSubPool& pool, int64_t rows, std::size_t writers) {
+	Result result;
+	result.mode = fmt::format("bulk writers={}", writers);
+	{
+		auto [ec, conn] = co_await pool.acquire();
+		if (ec)
+			throw std::runtime_error("acquire: " + ec.message());
+		co_await reset_table(conn);
+	}
+	MysqlBulkWriterConfig config;
+	config.writers = writers;
+	MysqlBulkWriter writer(pool, "bench_bulk", {"id", "name", "payload"}, config);
+	auto begin = std::chrono::steady_clock::now();
+	auto [run_ec, push_ec] = co_await folly::coro::collectAll(writer.run(), [&]() -> folly::coro::Task<boost::system::error_code> {
+		boost::system::error_code ec;
+		for (int64_t id = 0; id < rows && !ec; ++id)
+			ec = co_await writer.push(make_row(id));
+		writer.close();
+		co_return ec;
+	}());
+	if (run_ec || push_ec)
+		throw std::runtime_error(fmt::format("bulk writer: {}", (run_ec ? run_ec : push_ec).message()));
+	result.elapsed = std::chrono::steady_clock::now() - begin;
+	result.rows = writer.rowsWritten();
+	result.batches = writer.batchCount();
+	result.final_batch_rows = writer.batchRows();
+	co_return result;
+}
+
+// ./bench_mysql_bulk [rows] [host] [port], against the mariadb of mysql/docker-compose.yml by default
+int main(int argc, char** argv) {
+	try {
+		int64_t rows = argc > 1 ? std::stoll(argv[1]) : 200000;
+		MysqlPoolConfig config;
+		config.host = argc > 2 ? argv[2] : "127.0.0.1";
+		config.port = argc > 3 ? argv[3] : "3309";
+		config.user = "mybb";
+		config.password = "changeme";
+		config.database = "mybb";
+		config.min_size = 0;
+		config.max_size = 8;
+
+		IoContextPool ctx_pool{1};
+		ctx_pool.start();
+		MysqlPool pool(config);
+		auto& ctx = ctx_pool.getIoContext();
+		Executor executor{ctx};
+		auto& sub_pool = pool.subPool(ctx);
+		auto results = folly::coro::blockingWait([&]() -> folly::coro::Task<std::vector<Result>> {
+			std::vector<Result> results;
+			// row at a time is two orders of magnitude slower, a tenth of the rows is enough to see it
+			results.emplace_back(co_await run_single(sub_pool, std::max<int64_t>(1, rows / 10)));
+			for (std::size_t writers : {1, 2, 4})
+				results.emplace_back(co_await run_bulk(sub_pool, rows, writers));
+			co_return results;
+		}().scheduleOn(&executor));
+		ctx_pool.stop();
+
+		fmt::print("{:<20}{:>12}{:>12}{:>14}{:>16}\n", "mode", "rows", "batches", "rows/s", "final batch");
+		for (auto& r : results) {
+			fmt::print("{:<20}{:>12}{:>12}{:>14.0f}{:>16}\n", r.mode, r.rows, r.batches, r.rows / r.elapsed.count(), r.final_batch_rows);
+		}
+	} catch (std::exception& e) {
+		spdlog::error("Exception: {}", e.what());
+	}
+	return 0;
+}
@@ -0,0 +1,109 @@
+#include <io_context_pool.h>
+#include <hdr_histogram.h>
+#include <mysql_pipeline.h>
+#include <mysql_pool.h>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <folly/experimental/coro/BlockingWait.h>
+
+struct Result {
+	std::string mode;
+	// nanoseconds per logical request of all its statements
+	HdrHistogram latency{1, 60LL * 1000 * 1000 * 1000, 3};
+	int64_t requests{0};
+	std::chrono::duration<double> elapsed{};
+};
+
+std::vector<std::string> make_statements(int32_t count) {
+	std::vector<std::string> statements;
+	for (int32_t i = 0; i < count; ++i)
+		statements.emplace_back(fmt::format("SELECT {}, 'lookup-{}'", i, i));
+	return statements;
+}
+
+// one statement at a time, as test_boost_mysql does: a round trip each
+folly::coro::Task<Result> run_sequential(MysqlHandle& conn, const std::vector<std::string>& statements, int32_t requests) {
+	Result result;
+	result.mode = fmt::format("sequential x{}", statements.size());
+	auto begin = std::chrono::steady_clock::now();
+	for (int32_t i = 0; i < requests; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		for (auto& sql : statements) {
+			auto [ec, ei, resultset] = co_await async_query(*conn, sql);
+			if (!ec)
+				std::tie(ec, ei, std::ignore) = co_await read_all(resultset);
+			if (ec)
+				throw std::runtime_error(fmt::format("{}: {}-{}", sql, ec.message(), ei.message()));
+		}
+		result.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+		result.requests++;
+	}
+	result.elapsed = std::chrono::steady_clock::now() - begin;
+	co_return result;
+}
+
+folly::coro::Task<Result> run_pipelined(MysqlHandle& conn, const std::vector<std::string>& statements, int32_t requests) {
+	Result result;
+	result.mode = fmt::format("pipelined x{}", statements.size());
+	auto begin = std::chrono::steady_clock::now();
+	for (int32_t i = 0; i < requests; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		auto [ec, results] = co_await async_pipeline(*conn, statements);
+		if (ec)
+			throw std::runtime_error("pipeline: " + ec.message());
+		for (auto& r : results) {
+			if (!r.ok())
+				throw std::runtime_error(fmt::format("pipeline statement: {} {}", r.error_code, r.error_message));
+		}
+		result.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+		result.requests++;
+	}
+	result.elapsed = std::chrono::steady_clock::now() - begin;
+	co_return result;
+}
+
+// ./bench_mysql_pipeline [requests] [host] [port], against the mariadb of mysql/docker-compose.yml by default
+int main(int argc, char** argv) {
+	try {
+		int32_t requests = argc > 1 ? std::stoi(argv[1]) : 2000;
+		MysqlPoolConfig config;
+		config.host = argc > 2 ? argv[2] : "127.0.0.1";
+		config.port = argc > 3 ? argv[3] : "3309";
+		config.user = "mybb";
+		config.password = "changeme";
+		config.database = "mybb";
+		config.min_size = 0;
+		config.max_size = 1;
+
+		IoContextPool ctx_pool{1};
+		ctx_pool.start();
+		MysqlPool pool(config);
+		auto& ctx = ctx_pool.getIoContext();
+		Executor executor{ctx};
+		auto results = folly::coro::blockingWait([&]() -> folly::coro::Task<std::vector<Result>> {
+			auto [ec, conn] = co_await pool.acquire(ctx);
+			if (ec)
+				throw std::runtime_error("acquire: " + ec.message());
+			std::vector<Result> results;
+			for (int32_t count : {2, 8, 32}) {
+				auto statements = make_statements(count);
+				results.emplace_back(co_await run_sequential(conn, statements, requests));
+				results.emplace_back(co_await run_pipelined(conn, statements, requests));
+			}
+			co_return results;
+		}().scheduleOn(&executor));
+		ctx_pool.stop();
+
+		fmt::print("{:<20}{:>12}{:>10}{:>10}{:>10}{:>10}\n", "mode", "req/s", "p50 us", "p99 us", "p99.9 us", "max us");
+		for (auto& r : results) {
+			auto us = [&](double percentile) { return r.latency.valueAtPercentile(percentile) / 1000.0; };
+			fmt::print("{:<20}{:>12.0f}{:>10.1f}{:>10.1f}{:>10.1f}{:>10.1f}\n", r.mode, r.requests / r.elapsed.count(), us(50), us(99), us(99.9),
+				r.latency.max() / 1000.0);
+		}
+	} catch (std::exception& e) {
+		spdlog::error("Exception: {}", e.what());
+	}
+	return 0;
+}
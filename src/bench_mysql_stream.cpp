@@ -0,0 +1,126 @@
+#include <io_context_pool.h>
+#include <mysql_pool.h>
+
+#include <fstream>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <folly/experimental/coro/BlockingWait.h>
+
+struct Result {
+	std::string mode;
+	int64_t rows{0};
+	std::chrono::duration<double> first_row{};
+	std::chrono::duration<double> elapsed{};
+	// peak resident set above the resident set at the start, kB
+	int64_t peak_kb{0};
+};
+
+// VmRSS or VmHWM of /proc/self/status in kB
+int64_t proc_status_kb(const std::string& field) {
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.starts_with(field + ":"))
+			return std::stoll(line.substr(field.size() + 1));
+	}
+	return 0;
+}
+
+// resets VmHWM to the current resident set, so the peak of one run is not hidden by an earlier one
+void reset_peak_rss() {
+	std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+// MariaDB's sequence engine fills the table in one statement, the rows only travel once it is queried
+folly::coro::Task<void> prepare_table(MysqlHandle& conn, int64_t rows) {
+	auto [count_ec, count_ei, count_result] = co_await async_query(*conn, "SELECT COUNT(*) FROM bench_stream");
+	if (!count_ec) {
+		auto [ec, ei, count] = co_await read_all(count_result);
+		std::stringstream ss;
+		if (!ec && !count.empty())
+			ss << count[0].values()[0];
+		if (ss.str() == std::to_string(rows))
+			co_return;
+	}
+	for (auto sql : {std::string{"DROP TABLE IF EXISTS bench_stream"},
+			 std::string{"CREATE TABLE bench_stream(id BIGINT NOT NULL PRIMARY KEY, name VARCHAR(32), payload VARCHAR(128))"},
+			 fmt::format("INSERT INTO bench_stream SELECT seq, CONCAT('name-', seq), REPEAT('x', 100) FROM seq_1_to_{}", rows)}) {
+		auto [ec, ei, _] = co_await async_query(*conn, sql);
+		if (ec)
+			throw std::runtime_error(fmt::format("{}: {}-{}", sql, ec.message(), ei.message()));
+	}
+	spdlog::info("bench_stream filled with {} rows", rows);
+}
+
+// batch_size 0 reads the whole result set with read_all
+folly::coro::Task<Result> run(MysqlHandle& conn, std::size_t batch_size) {
+	Result result;
+	result.mode = batch_size == 0 ? "read_all" : fmt::format("stream batch={}", batch_size);
+	reset_peak_rss();
+	auto rss = proc_status_kb("VmRSS");
+	auto begin = std::chrono::steady_clock::now();
+	auto [ec, ei, resultset] = co_await async_query(*conn, "SELECT id, name, payload FROM bench_stream");
+	if (ec)
+		throw std::runtime_error(fmt::format("query: {}-{}", ec.message(), ei.message()));
+	if (batch_size == 0) {
+		auto [read_ec, read_ei, rows] = co_await read_all(resultset);
+		if (read_ec)
+			throw std::runtime_error(fmt::format("read_all: {}-{}", read_ec.message(), read_ei.message()));
+		result.first_row = std::chrono::steady_clock::now() - begin;
+		result.rows = static_cast<int64_t>(rows.size());
+		result.peak_kb = proc_status_kb("VmHWM") - rss;
+	}
+	else {
+		auto rows = stream_rows(resultset, batch_size);
+		while (auto row = co_await rows.next()) {
+			if (result.rows++ == 0)
+				result.first_row = std::chrono::steady_clock::now() - begin;
+		}
+		result.peak_kb = proc_status_kb("VmHWM") - rss;
+	}
+	result.elapsed = std::chrono::steady_clock::now() - begin;
+	co_return result;
+}
+
+// ./bench_mysql_stream [rows] [host] [port], against the mariadb of mysql/docker-compose.yml by default
+int main(int argc, char** argv) {
+	try {
+		int64_t rows = argc > 1 ? std::stoll(argv[1]) : 1000000;
+		MysqlPoolConfig config;
+		config.host = argc > 2 ? argv[2] : "127.0.0.1";
+		config.port = argc > 3 ? argv[3] : "3309";
+		config.user = "mybb";
+		config.password = "changeme";
+		config.database = "mybb";
+		config.min_size = 0;
+		config.max_size = 1;
+
+		IoContextPool ctx_pool{1};
+		ctx_pool.start();
+		MysqlPool pool(config);
+		auto& ctx = ctx_pool.getIoContext();
+		Executor executor{ctx};
+		auto results = folly::coro::blockingWait([&]() -> folly::coro::Task<std::vector<Result>> {
+			auto [ec, conn] = co_await pool.acquire(ctx);
+			if (ec)
+				throw std::runtime_error("acquire: " + ec.message());
+			co_await prepare_table(conn, rows);
+			std::vector<Result> results;
+			for (std::size_t batch_size : {1, 64, 1024, 0})
+				results.emplace_back(co_await run(conn, batch_size));
+			co_return results;
+		}().scheduleOn(&executor));
+		ctx_pool.stop();
+
+		fmt::print("{:<20}{:>12}{:>16}{:>12}{:>14}{:>16}\n", "mode", "rows", "first row ms", "total s", "rows/s", "peak rss MiB");
+		for (auto& r : results) {
+			fmt::print("{:<20}{:>12}{:>16.2f}{:>12.2f}{:>14.0f}{:>16.1f}\n", r.mode, r.rows, r.first_row.count() * 1000, r.elapsed.count(),
+				r.rows / r.elapsed.count(), r.peak_kb / 1024.0);
+		}
+	} catch (std::exception& e) {
+		spdlog::error("Exception: {}", e.what());
+	}
+	return 0;
+}
@@ -0,0 +1,348 @@
+#include <io_context_pool.h>
+#include <asio_util.hpp>
+#include <tls_util.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include <spdlog/spdlog.h>
+
+#include <folly/experimental/coro/BlockingWait.h>
+
+enum class Mode {
+	Plain,
+	AsioSsl,
+	KernelTls,
+	KernelTlsSendfile,
+};
+
+enum class Workload {
+	Echo,
+	Bulk,
+};
+
+const char* to_string(Mode mode) {
+	switch (mode) {
+	case Mode::Plain:
+		return "plain";
+	case Mode::AsioSsl:
+		return "asio-ssl";
+	case Mode::KernelTls:
+		return "ktls";
+	case Mode::KernelTlsSendfile:
+		return "ktls-sendfile";
+	}
+	return "unknown";
+}
+
+// self-signed P-256 certificate for localhost, written next to the key in dir
+TlsConfig make_self_signed_certificate(const std::filesystem::path& dir) {
+	std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> pkey_ctx(EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr), EVP_PKEY_CTX_free);
+	EVP_PKEY* raw_pkey = nullptr;
+	if (EVP_PKEY_keygen_init(pkey_ctx.get()) <= 0 || EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pkey_ctx.get(), NID_X9_62_prime256v1) <= 0 ||
+		EVP_PKEY_keygen(pkey_ctx.get(), &raw_pkey) <= 0)
+		throw std::runtime_error("generate private key failed");
+	std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> pkey(raw_pkey, EVP_PKEY_free);
+	std::unique_ptr<X509, decltype(&X509_free)> x509(X509_new(), X509_free);
+	X509_set_version(x509.get(), 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(x509.get()), 1);
+	X509_gmtime_adj(X509_getm_notBefore(x509.get()), 0);
+	X509_gmtime_adj(X509_getm_notAfter(x509.get()), 24 * 3600);
+	X509_set_pubkey(x509.get(), pkey.get());
+	auto name = X509_get_subject_name(x509.get());
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+	X509_set_issuer_name(x509.get(), name);
+	if (X509_sign(x509.get(), pkey.get(), EVP_sha256()) == 0)
+		throw std::runtime_error("sign certificate failed");
+
+	TlsConfig config{(dir / "bench_tls.crt").string(), (dir / "bench_tls.key").string(), true, true};
+	std::unique_ptr<FILE, decltype(&fclose)> cert_file(fopen(config.cert_file.c_str(), "w"), fclose);
+	std::unique_ptr<FILE, decltype(&fclose)> key_file(fopen(config.key_file.c_str(), "w"), fclose);
+	if (!cert_file || !key_file)
+		throw std::runtime_error("open certificate files failed");
+	PEM_write_X509(cert_file.get(), x509.get());
+	PEM_write_PrivateKey(key_file.get(), pkey.get(), nullptr, nullptr, 0, nullptr, nullptr);
+	return config;
+}
+
+class TlsBench final {
+public:
+	TlsBench(boost::asio::io_context& server_context, boost::asio::io_context& client_context, const TlsConfig& config,
+		const std::filesystem::path& dir)
+		: m_server_context(server_context)
+		, m_client_context(client_context)
+		, m_server_executor(server_context)
+		, m_client_executor(client_context)
+		, m_acceptor(server_context, boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0))
+		, m_port(std::to_string(m_acceptor.local_endpoint().port()))
+		, m_server_ssl_context(make_tls_server_context(config))
+		, m_client_ssl_context(make_tls_client_context(config.ktls))
+		, m_resume_ssl_context(make_tls_client_context(config.ktls))
+		, m_session_cache(m_resume_ssl_context.native_handle())
+		, m_chunk(64 * 1024, 'x') {
+		// the sendfile source, the page cache keeps it hot after the first pass
+		auto file_path = (dir / "bench_tls.data").string();
+		m_file_fd = ::open(file_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+		if (m_file_fd < 0)
+			throw std::runtime_error("open " + file_path + " failed");
+		for (size_t written = 0; written < m_file_size; written += m_chunk.size())
+			if (::write(m_file_fd, m_chunk.data(), m_chunk.size()) < 0)
+				throw std::runtime_error("write " + file_path + " failed");
+	}
+
+	~TlsBench() {
+		::close(m_file_fd);
+	}
+
+	Executor& clientExecutor() { return m_client_executor; }
+
+	folly::coro::Task<void> handshake(Mode mode, bool resume, size_t count) {
+		serve(mode, Workload::Echo, count, 0).scheduleOn(&m_server_executor).start();
+		auto& ssl_context = resume ? m_resume_ssl_context : m_client_ssl_context;
+		size_t reused = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < count; ++i) {
+			boost::asio::ip::tcp::socket socket(m_client_context);
+			if (!co_await connect(socket))
+				co_return;
+			if (mode == Mode::Plain) {
+				co_await echoOnce(socket);
+			}
+			else if (mode == Mode::AsioSsl) {
+				boost::asio::ssl::stream<boost::asio::ip::tcp::socket> stream(std::move(socket), ssl_context);
+				if (!co_await clientHandshake(stream, resume))
+					co_return;
+				co_await echoOnce(stream);
+				reused += SSL_session_reused(stream.native_handle());
+			}
+			else {
+				TlsSocket stream(std::move(socket), ssl_context.native_handle());
+				if (!co_await clientHandshake(stream, resume))
+					co_return;
+				co_await echoOnce(stream);
+				reused += SSL_session_reused(stream.native_handle());
+			}
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		spdlog::info("[handshake] mode: {:<14} resume: {:<5} connections: {} reused: {} elapsed: {:.3f}s rate: {:.0f}/s",
+			to_string(mode), resume, count, reused, elapsed.count(), count / elapsed.count());
+		co_return;
+	}
+
+	folly::coro::Task<void> bulk(Mode mode, size_t bytes) {
+		serve(mode, Workload::Bulk, 1, bytes).scheduleOn(&m_server_executor).start();
+		boost::asio::ip::tcp::socket socket(m_client_context);
+		if (!co_await connect(socket))
+			co_return;
+		size_t received = 0;
+		bool ktls = false;
+		auto start = std::chrono::steady_clock::now();
+		if (mode == Mode::Plain) {
+			received = co_await drain(socket, bytes);
+		}
+		else if (mode == Mode::AsioSsl) {
+			boost::asio::ssl::stream<boost::asio::ip::tcp::socket> stream(std::move(socket), m_client_ssl_context);
+			if (!co_await clientHandshake(stream, false))
+				co_return;
+			start = std::chrono::steady_clock::now();
+			received = co_await drain(stream, bytes);
+		}
+		else {
+			TlsSocket stream(std::move(socket), m_client_ssl_context.native_handle());
+			if (!co_await clientHandshake(stream, false))
+				co_return;
+			ktls = stream.ktlsRecv();
+			start = std::chrono::steady_clock::now();
+			received = co_await drain(stream, bytes);
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		spdlog::info("[bulk] mode: {:<14} client ktls rx: {:<5} bytes: {} elapsed: {:.3f}s throughput: {:.1f}MB/s",
+			to_string(mode), ktls, received, elapsed.count(), received / elapsed.count() / (1024 * 1024));
+		if (received != bytes)
+			spdlog::error("[bulk] mode: {} expected {} bytes, received {}", to_string(mode), bytes, received);
+		co_return;
+	}
+
+private:
+	folly::coro::Task<void> serve(Mode mode, Workload workload, size_t count, size_t bytes) {
+		for (size_t i = 0; i < count; ++i) {
+			boost::asio::ip::tcp::socket socket(m_server_context);
+			if (auto ec = co_await async_accept(m_acceptor, socket)) {
+				spdlog::error("Accept failed, error: {}", ec.message());
+				co_return;
+			}
+			socket.set_option(boost::asio::ip::tcp::no_delay(true));
+			if (mode == Mode::Plain)
+				serverSession(std::move(socket), mode, workload, bytes).scheduleOn(&m_server_executor).start();
+			else if (mode == Mode::AsioSsl)
+				serverSession(boost::asio::ssl::stream<boost::asio::ip::tcp::socket>{std::move(socket), m_server_ssl_context}, mode, workload, bytes)
+					.scheduleOn(&m_server_executor)
+					.start();
+			else
+				serverSession(TlsSocket{std::move(socket), m_server_ssl_context.native_handle()}, mode, workload, bytes)
+					.scheduleOn(&m_server_executor)
+					.start();
+		}
+		co_return;
+	}
+
+	template <typename Stream>
+	folly::coro::Task<void> serverSession(Stream stream, Mode mode, Workload workload, size_t bytes) {
+		if constexpr (!std::is_same_v<Stream, boost::asio::ip::tcp::socket>) {
+			if (auto ec = co_await async_handshake(stream, boost::asio::ssl::stream_base::server)) {
+				spdlog::error("[server] handshake: {}", ec.message());
+				co_return;
+			}
+		}
+		if (workload == Workload::Echo) {
+			char data[1];
+			for (;;) {
+				auto [ec, length] = co_await async_read_some(stream, boost::asio::buffer(data));
+				if (ec)
+					break;
+				co_await async_write(stream, boost::asio::buffer(data, length));
+			}
+		}
+		else if constexpr (std::is_same_v<Stream, TlsSocket>) {
+			if (mode == Mode::KernelTlsSendfile)
+				co_await sendfile(stream, bytes);
+			else
+				co_await send(stream, bytes);
+			stream.shutdown();
+		}
+		else {
+			co_await send(stream, bytes);
+		}
+		boost::system::error_code ec;
+		stream.lowest_layer().shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+		stream.lowest_layer().close(ec);
+		co_return;
+	}
+
+	template <typename Stream>
+	folly::coro::Task<void> send(Stream& stream, size_t bytes) {
+		for (size_t sent = 0; sent < bytes;) {
+			auto [ec, length] = co_await async_write(stream, boost::asio::buffer(m_chunk.data(), std::min(bytes - sent, m_chunk.size())));
+			if (ec) {
+				spdlog::error("[server] write: {}", ec.message());
+				break;
+			}
+			sent += length;
+		}
+		co_return;
+	}
+
+	folly::coro::Task<void> sendfile(TlsSocket& stream, size_t bytes) {
+		if (!stream.ktlsSend())
+			spdlog::warn("[server] kernel TLS tx is not active, sendfile is not available (tls module loaded? OpenSSL 3?)");
+		for (size_t sent = 0; sent < bytes;) {
+			auto [ec, length] = co_await stream.sendfile(m_file_fd, 0, std::min(bytes - sent, m_file_size));
+			if (ec) {
+				spdlog::error("[server] sendfile: {}", ec.message());
+				break;
+			}
+			sent += length;
+		}
+		co_return;
+	}
+
+	folly::coro::Task<bool> connect(boost::asio::ip::tcp::socket& socket) {
+		if (auto ec = co_await async_connect(m_client_context, socket, "127.0.0.1", m_port)) {
+			spdlog::error("Connect error: {}", ec.message());
+			co_return false;
+		}
+		socket.set_option(boost::asio::ip::tcp::no_delay(true));
+		co_return true;
+	}
+
+	template <typename Stream>
+	folly::coro::Task<bool> clientHandshake(Stream& stream, bool resume) {
+		if (resume)
+			m_session_cache.prepare(stream.native_handle(), "localhost");
+		if (auto ec = co_await async_handshake(stream, boost::asio::ssl::stream_base::client)) {
+			spdlog::error("[client] handshake: {}", ec.message());
+			co_return false;
+		}
+		co_return true;
+	}
+
+	// one round trip, which also lets the client pick up the TLS 1.3 session ticket
+	template <typename Stream>
+	folly::coro::Task<void> echoOnce(Stream& stream) {
+		char data[1]{'x'};
+		co_await async_write(stream, boost::asio::buffer(data));
+		co_await async_read_some(stream, boost::asio::buffer(data));
+		if constexpr (!std::is_same_v<Stream, boost::asio::ip::tcp::socket>) {
+			// a session that was not shut down is dropped by OpenSSL and could not be resumed
+			SSL_set_shutdown(stream.native_handle(), SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+		}
+		boost::system::error_code ec;
+		stream.lowest_layer().close(ec);
+		co_return;
+	}
+
+	template <typename Stream>
+	folly::coro::Task<size_t> drain(Stream& stream, size_t bytes) {
+		std::vector<char> data(m_chunk.size());
+		size_t received = 0;
+		while (received < bytes) {
+			auto [ec, length] = co_await async_read_some(stream, boost::asio::buffer(data));
+			if (ec) {
+				spdlog::error("[client] read: {}", ec.message());
+				break;
+			}
+			received += length;
+		}
+		boost::system::error_code ec;
+		stream.lowest_layer().close(ec);
+		co_return received;
+	}
+
+	boost::asio::io_context& m_server_context;
+	boost::asio::io_context& m_client_context;
+	Executor m_server_executor;
+	Executor m_client_executor;
+	boost::asio::ip::tcp::acceptor m_acceptor;
+	std::string m_port;
+	boost::asio::ssl::context m_server_ssl_context;
+	boost::asio::ssl::context m_client_ssl_context;
+	boost::asio::ssl::context m_resume_ssl_context;
+	TlsSessionCache m_session_cache;
+	std::string m_chunk;
+	int m_file_fd{-1};
+	size_t m_file_size{16 * 1024 * 1024};
+};
+
+// sudo modprobe tls
+// ./bench_tls [handshakes] [bulk MB]
+int main(int argc, char** argv) {
+	try {
+		size_t handshakes = argc > 1 ? std::stoul(argv[1]) : 1000;
+		size_t bulk_bytes = (argc > 2 ? std::stoul(argv[2]) : 1024) * 1024 * 1024;
+		auto dir = std::filesystem::temp_directory_path();
+		auto config = make_self_signed_certificate(dir);
+
+		IoContextPool pool(2);
+		pool.start();
+		auto& server_context = pool.getIoContext();
+		auto& client_context = pool.getIoContext();
+		TlsBench bench(server_context, client_context, config, dir);
+		for (auto mode : {Mode::Plain, Mode::AsioSsl, Mode::KernelTls}) {
+			folly::coro::blockingWait(bench.handshake(mode, false, handshakes).scheduleOn(&bench.clientExecutor()));
+			if (mode != Mode::Plain)
+				folly::coro::blockingWait(bench.handshake(mode, true, handshakes).scheduleOn(&bench.clientExecutor()));
+		}
+		for (auto mode : {Mode::Plain, Mode::AsioSsl, Mode::KernelTls, Mode::KernelTlsSendfile})
+			folly::coro::blockingWait(bench.bulk(mode, bulk_bytes).scheduleOn(&bench.clientExecutor()));
+		pool.stop();
+	} catch (std::exception& e) {
+		spdlog::error("Exception: {}", e.what());
+	}
+	return 0;
+}
@@ -0,0 +1,516 @@
+#include <io_context_pool.h>
+#include <asio_util.hpp>
+#include <hdr_histogram.h>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <trantor/net/Channel.h>
+#include <trantor/net/EventLoopThread.h>
+#include <trantor/net/EventLoopThreadPool.h>
+#include <trantor/net/TcpServer.h>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+enum class Transport {
+	Loopback,
+	Socketpair,
+};
+
+enum class Workload {
+	Echo,
+	RequestResponse,
+};
+
+constexpr size_t kBufferSize = 64 * 1024;
+
+// Every implementation is an echo server, the workload is decided by the client.
+class BenchServer {
+public:
+	virtual ~BenchServer() = default;
+	virtual std::string name() const = 0;
+	// listen on 127.0.0.1, returns the port
+	virtual uint16_t listen() = 0;
+	// serve the server end of a socketpair
+	virtual void adopt(int fd) = 0;
+};
+
+uint16_t pick_port() {
+	boost::asio::io_context io_context;
+	boost::asio::ip::tcp::acceptor acceptor(io_context, boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+	return acceptor.local_endpoint().port();
+}
+
+// folly::coro tasks on asio, the TcpServer stack
+class FollyCoroServer final : public BenchServer {
+public:
+	explicit FollyCoroServer(int32_t threads)
+		: m_pool(threads) {
+		for (int32_t i = 0; i < threads; ++i) {
+			auto& context = m_pool.getIoContext();
+			m_contexts.emplace_back(&context);
+			m_executors.emplace_back(std::make_unique<Executor>(context));
+		}
+		m_pool.start();
+	}
+	~FollyCoroServer() { m_pool.stop(); }
+
+	std::string name() const override { return "folly-coro"; }
+
+	uint16_t listen() override {
+		m_acceptor = std::make_unique<boost::asio::ip::tcp::acceptor>(*m_contexts[0],
+			boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+		accept().scheduleOn(m_executors[0].get()).start();
+		return m_acceptor->local_endpoint().port();
+	}
+
+	void adopt(int fd) override {
+		auto index = m_next++ % m_contexts.size();
+		boost::asio::local::stream_protocol::socket socket(*m_contexts[index], boost::asio::local::stream_protocol(), fd);
+		session(std::move(socket)).scheduleOn(m_executors[index].get()).start();
+	}
+
+private:
+	folly::coro::Task<void> accept() {
+		for (;;) {
+			auto index = m_next++ % m_contexts.size();
+			boost::asio::ip::tcp::socket socket(*m_contexts[index]);
+			if (auto ec = co_await async_accept(*m_acceptor, socket)) {
+				spdlog::error("Accept failed, error: {}", ec.message());
+				co_return;
+			}
+			socket.set_option(boost::asio::ip::tcp::no_delay(true));
+			session(std::move(socket)).scheduleOn(m_executors[index].get()).start();
+		}
+	}
+
+	template <typename Socket>
+	folly::coro::Task<void> session(Socket socket) {
+		std::vector<char> data(kBufferSize);
+		for (;;) {
+			auto [ec, length] = co_await async_read_some(socket, boost::asio::buffer(data));
+			if (ec)
+				break;
+			auto [write_ec, _] = co_await async_write(socket, boost::asio::buffer(data.data(), length));
+			if (write_ec)
+				break;
+		}
+		boost::system::error_code ec;
+		socket.close(ec);
+		co_return;
+	}
+
+	IoContextPool m_pool;
+	std::vector<boost::asio::io_context*> m_contexts;
+	std::vector<std::unique_ptr<Executor>> m_executors;
+	std::unique_ptr<boost::asio::ip::tcp::acceptor> m_acceptor;
+	std::atomic<size_t> m_next{0};
+};
+
+// plain completion handlers, no coroutine frames at all
+class AsioCallbackServer final : public BenchServer {
+public:
+	explicit AsioCallbackServer(int32_t threads)
+		: m_pool(threads) {
+		for (int32_t i = 0; i < threads; ++i)
+			m_contexts.emplace_back(&m_pool.getIoContext());
+		m_pool.start();
+	}
+	~AsioCallbackServer() { m_pool.stop(); }
+
+	std::string name() const override { return "asio-callback"; }
+
+	uint16_t listen() override {
+		m_acceptor = std::make_unique<boost::asio::ip::tcp::acceptor>(*m_contexts[0],
+			boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+		accept();
+		return m_acceptor->local_endpoint().port();
+	}
+
+	void adopt(int fd) override {
+		auto& context = *m_contexts[m_next++ % m_contexts.size()];
+		boost::asio::local::stream_protocol::socket socket(context, boost::asio::local::stream_protocol(), fd);
+		boost::asio::post(context, [session = std::make_shared<Session<decltype(socket)>>(std::move(socket))] { session->read(); });
+	}
+
+private:
+	template <typename Socket>
+	class Session : public std::enable_shared_from_this<Session<Socket>> {
+	public:
+		explicit Session(Socket socket)
+			: m_socket(std::move(socket))
+			, m_data(kBufferSize) {
+		}
+
+		void read() {
+			m_socket.async_read_some(boost::asio::buffer(m_data), [self = this->shared_from_this()](boost::system::error_code ec, size_t length) {
+				if (!ec)
+					self->write(length);
+			});
+		}
+
+		void write(size_t length) {
+			boost::asio::async_write(m_socket, boost::asio::buffer(m_data.data(), length), [self = this->shared_from_this()](boost::system::error_code ec, size_t) {
+				if (!ec)
+					self->read();
+			});
+		}
+
+	private:
+		Socket m_socket;
+		std::vector<char> m_data;
+	};
+
+	void accept() {
+		auto& context = *m_contexts[m_next++ % m_contexts.size()];
+		m_acceptor->async_accept(context, [this](boost::system::error_code ec, boost::asio::ip::tcp::socket socket) {
+			if (ec) {
+				spdlog::error("Accept failed, error: {}", ec.message());
+				return;
+			}
+			socket.set_option(boost::asio::ip::tcp::no_delay(true));
+			auto executor = socket.get_executor();
+			boost::asio::post(executor, [session = std::make_shared<Session<boost::asio::ip::tcp::socket>>(std::move(socket))] { session->read(); });
+			accept();
+		});
+	}
+
+	IoContextPool m_pool;
+	std::vector<boost::asio::io_context*> m_contexts;
+	std::unique_ptr<boost::asio::ip::tcp::acceptor> m_acceptor;
+	std::atomic<size_t> m_next{0};
+};
+
+// asio's own C++20 coroutine support
+class AsioCoroutineServer final : public BenchServer {
+public:
+	explicit AsioCoroutineServer(int32_t threads)
+		: m_pool(threads) {
+		for (int32_t i = 0; i < threads; ++i)
+			m_contexts.emplace_back(&m_pool.getIoContext());
+		m_pool.start();
+	}
+	~AsioCoroutineServer() { m_pool.stop(); }
+
+	std::string name() const override { return "asio-awaitable"; }
+
+	uint16_t listen() override {
+		m_acceptor = std::make_unique<boost::asio::ip::tcp::acceptor>(*m_contexts[0],
+			boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+		boost::asio::co_spawn(*m_contexts[0], accept(), boost::asio::detached);
+		return m_acceptor->local_endpoint().port();
+	}
+
+	void adopt(int fd) override {
+		auto& context = *m_contexts[m_next++ % m_contexts.size()];
+		boost::asio::local::stream_protocol::socket socket(context, boost::asio::local::stream_protocol(), fd);
+		boost::asio::co_spawn(context, session(std::move(socket)), boost::asio::detached);
+	}
+
+private:
+	boost::asio::awaitable<void> accept() {
+		for (;;) {
+			auto& context = *m_contexts[m_next++ % m_contexts.size()];
+			boost::asio::ip::tcp::socket socket(context);
+			boost::system::error_code ec;
+			co_await m_acceptor->async_accept(socket, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+			if (ec) {
+				spdlog::error("Accept failed, error: {}", ec.message());
+				co_return;
+			}
+			socket.set_option(boost::asio::ip::tcp::no_delay(true));
+			boost::asio::co_spawn(context, session(std::move(socket)), boost::asio::detached);
+		}
+	}
+
+	template <typename Socket>
+	boost::asio::awaitable<void> session(Socket socket) {
+		std::vector<char> data(kBufferSize);
+		for (;;) {
+			boost::system::error_code ec;
+			auto length = co_await socket.async_read_some(boost::asio::buffer(data), boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+			if (ec)
+				break;
+			co_await boost::asio::async_write(socket, boost::asio::buffer(data.data(), length), boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+			if (ec)
+				break;
+		}
+	}
+
+	IoContextPool m_pool;
+	std::vector<boost::asio::io_context*> m_contexts;
+	std::unique_ptr<boost::asio::ip::tcp::acceptor> m_acceptor;
+	std::atomic<size_t> m_next{0};
+};
+
+// trantor, the drogon network layer. trantor::TcpConnection can only be created by its TcpServer/TcpClient,
+// so socketpair ends are served by a bare trantor::Channel on the same event loops.
+class TrantorServer final : public BenchServer {
+public:
+	explicit TrantorServer(int32_t threads)
+		: m_threads(threads)
+		, m_loop_pool(threads) {
+		m_loop_thread.run();
+		m_loop_pool.start();
+	}
+	~TrantorServer() {
+		if (m_server)
+			m_server->stop();
+	}
+
+	std::string name() const override { return "trantor"; }
+
+	uint16_t listen() override {
+		auto port = pick_port();
+		m_server = std::make_unique<trantor::TcpServer>(m_loop_thread.getLoop(), trantor::InetAddress("127.0.0.1", port), "bench_transport");
+		m_server->setConnectionCallback([](const trantor::TcpConnectionPtr& conn) {
+			if (conn->connected())
+				conn->setTcpNoDelay(true);
+		});
+		m_server->setRecvMessageCallback([](const trantor::TcpConnectionPtr& conn, trantor::MsgBuffer* buffer) {
+			conn->send(buffer->peek(), buffer->readableBytes());
+			buffer->retrieveAll();
+		});
+		m_server->setIoLoopNum(m_threads);
+		m_server->start();
+		return port;
+	}
+
+	void adopt(int fd) override {
+		::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+		auto loop = m_loop_pool.getNextLoop();
+		auto session = std::make_shared<ChannelSession>(loop, fd);
+		m_sessions.emplace_back(session);
+		loop->runInLoop([session] { session->start(); });
+	}
+
+private:
+	struct ChannelSession {
+		ChannelSession(trantor::EventLoop* loop, int fd)
+			: m_fd(fd)
+			, m_channel(loop, fd) {
+		}
+		~ChannelSession() { ::close(m_fd); }
+
+		void start() {
+			m_channel.setReadCallback([this] { onRead(); });
+			m_channel.setWriteCallback([this] { flush(); });
+			m_channel.enableReading();
+		}
+
+		void onRead() {
+			char data[kBufferSize];
+			auto length = ::read(m_fd, data, sizeof(data));
+			if (length <= 0) {
+				if (length < 0 && errno == EAGAIN)
+					return;
+				m_channel.disableAll();
+				m_channel.remove();
+				return;
+			}
+			m_pending.append(data, length);
+			flush();
+		}
+
+		void flush() {
+			while (!m_pending.empty()) {
+				auto length = ::write(m_fd, m_pending.data(), m_pending.size());
+				if (length <= 0)
+					break;
+				m_pending.erase(0, length);
+			}
+			if (m_pending.empty() && m_channel.isWriting())
+				m_channel.disableWriting();
+			else if (!m_pending.empty() && !m_channel.isWriting())
+				m_channel.enableWriting();
+		}
+
+		int m_fd;
+		trantor::Channel m_channel;
+		std::string m_pending;
+	};
+
+	int32_t m_threads;
+	trantor::EventLoopThread m_loop_thread;
+	trantor::EventLoopThreadPool m_loop_pool;
+	std::unique_ptr<trantor::TcpServer> m_server;
+	std::vector<std::shared_ptr<ChannelSession>> m_sessions;
+};
+
+struct Result {
+	std::string server;
+	Transport transport;
+	Workload workload;
+	int64_t operations{0};
+	int64_t bytes{0};
+	std::chrono::duration<double> elapsed{0};
+	HdrHistogram latency{1, 3600LL * 1000 * 1000 * 1000, 3};
+};
+
+int connect_loopback(uint16_t port) {
+	int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+		throw std::runtime_error(fmt::format("connect 127.0.0.1:{} failed: {}", port, strerror(errno)));
+	int one = 1;
+	::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	return fd;
+}
+
+// Blocking client threads, identical for every server so only the server side differs.
+// Echo streams payload_size writes for the whole duration and counts echoed bytes,
+// RequestResponse sends one payload_size request and waits for the full reply before the next.
+void run_clients(const std::vector<int>& fds, Workload workload, size_t payload_size, std::chrono::seconds duration, Result& result) {
+	std::vector<std::thread> threads;
+	std::vector<Result> partial(fds.size());
+	auto deadline = std::chrono::steady_clock::now() + duration;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < fds.size(); ++i) {
+		auto fd = fds[i];
+		auto& stats = partial[i];
+		if (workload == Workload::Echo) {
+			threads.emplace_back([=] {
+				std::string payload(payload_size, 'x');
+				while (std::chrono::steady_clock::now() < deadline)
+					if (::send(fd, payload.data(), payload.size(), MSG_NOSIGNAL) <= 0)
+						break;
+			});
+			threads.emplace_back([=, &stats] {
+				std::vector<char> data(kBufferSize);
+				for (;;) {
+					auto length = ::recv(fd, data.data(), data.size(), 0);
+					if (length <= 0 || std::chrono::steady_clock::now() >= deadline)
+						break;
+					stats.bytes += length;
+				}
+			});
+		}
+		else {
+			threads.emplace_back([=, &stats] {
+				std::string payload(payload_size, 'x');
+				std::vector<char> data(payload_size);
+				while (std::chrono::steady_clock::now() < deadline) {
+					auto send_time = std::chrono::steady_clock::now();
+					if (::send(fd, payload.data(), payload.size(), MSG_NOSIGNAL) <= 0)
+						break;
+					size_t received = 0;
+					while (received < payload_size) {
+						auto length = ::recv(fd, data.data() + received, payload_size - received, 0);
+						if (length <= 0)
+							return;
+						received += length;
+					}
+					stats.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - send_time).count());
+					stats.operations++;
+					stats.bytes += received;
+				}
+			});
+		}
+	}
+	std::this_thread::sleep_until(deadline);
+	// unblocks readers and writers stuck in the kernel, the servers see EOF and drop the session
+	for (auto fd : fds)
+		::shutdown(fd, SHUT_RDWR);
+	for (auto& thread : threads)
+		thread.join();
+	result.elapsed = duration;
+	for (auto& stats : partial) {
+		result.operations += stats.operations;
+		result.bytes += stats.bytes;
+		result.latency.merge(stats.latency);
+	}
+	for (auto fd : fds)
+		::close(fd);
+	std::this_thread::sleep_until(start + duration + std::chrono::milliseconds(200));
+}
+
+Result run(const std::function<std::unique_ptr<BenchServer>()>& make_server, Transport transport, Workload workload,
+	int32_t connections, size_t payload_size, std::chrono::seconds duration) {
+	auto server = make_server();
+	Result result;
+	result.server = server->name();
+	result.transport = transport;
+	result.workload = workload;
+	std::vector<int> fds;
+	if (transport == Transport::Loopback) {
+		auto port = server->listen();
+		for (int32_t i = 0; i < connections; ++i)
+			fds.emplace_back(connect_loopback(port));
+	}
+	else {
+		for (int32_t i = 0; i < connections; ++i) {
+			int sv[2];
+			if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+				throw std::runtime_error(fmt::format("socketpair failed: {}", strerror(errno)));
+			server->adopt(sv[0]);
+			fds.emplace_back(sv[1]);
+		}
+	}
+	run_clients(fds, workload, payload_size, duration, result);
+	return result;
+}
+
+void print_table(const std::vector<Result>& results) {
+	fmt::print("{:<16}{:<12}{:<18}{:>14}{:>12}{:>10}{:>10}{:>10}{:>10}\n", "server", "transport", "workload", "ops/s", "MiB/s", "p50 us",
+		"p99 us", "p99.9 us", "max us");
+	for (auto& r : results) {
+		auto seconds = r.elapsed.count();
+		auto us = [&](double percentile) { return r.latency.valueAtPercentile(percentile) / 1000.0; };
+		bool has_latency = r.workload == Workload::RequestResponse;
+		fmt::print("{:<16}{:<12}{:<18}{:>14}{:>12.1f}{:>10}{:>10}{:>10}{:>10}\n", r.server,
+			r.transport == Transport::Loopback ? "loopback" : "socketpair",
+			r.workload == Workload::Echo ? "echo" : "request-response",
+			has_latency ? fmt::format("{:.0f}", r.operations / seconds) : "-",
+			r.bytes / seconds / (1024 * 1024),
+			has_latency ? fmt::format("{:.1f}", us(50)) : "-",
+			has_latency ? fmt::format("{:.1f}", us(99)) : "-",
+			has_latency ? fmt::format("{:.1f}", us(99.9)) : "-",
+			has_latency ? fmt::format("{:.1f}", r.latency.max() / 1000.0) : "-");
+	}
+}
+
+// ./bench_transport [server threads] [client connections] [seconds per run] [payload bytes]
+int main(int argc, char** argv) {
+	try {
+		int32_t threads = argc > 1 ? std::stoi(argv[1]) : 2;
+		int32_t connections = argc > 2 ? std::stoi(argv[2]) : 16;
+		std::chrono::seconds duration{argc > 3 ? std::stoi(argv[3]) : 5};
+		size_t payload_size = argc > 4 ? std::stoul(argv[4]) : 128;
+
+		std::vector<std::function<std::unique_ptr<BenchServer>()>> servers{
+			[&] { return std::make_unique<FollyCoroServer>(threads); },
+			[&] { return std::make_unique<AsioCallbackServer>(threads); },
+			[&] { return std::make_unique<AsioCoroutineServer>(threads); },
+			[&] { return std::make_unique<TrantorServer>(threads); },
+		};
+		std::vector<Result> results;
+		for (auto transport : {Transport::Loopback, Transport::Socketpair})
+			for (auto workload : {Workload::Echo, Workload::RequestResponse})
+				for (auto& make_server : servers) {
+					results.emplace_back(run(make_server, transport, workload, connections, payload_size, duration));
+					spdlog::info("finished {}", results.back().server);
+				}
+		print_table(results);
+	} catch (std::exception& e) {
+		spdlog::error("Exception: {}", e.what());
+	}
+	return 0;
+}
@@ -1,6 +1,7 @@
 #include "greeter_async_client.h"
-#include "greeter_async_server.h"
+#include "greeter_server_factory.h"
 
+#include "load_balancer.h"
 #include "xmake_example.h"
 
 #include <drogon/drogon.h>
@@ -143,8 +144,14 @@ int main(int argc, char** argv) {
 		spdlog::error("{}", e.what());
 	}
 	std::thread([] {
-		ServerImpl server;
-		server.Run();
+		// GREETER_SERVER_MODE=callback serves from gRPC's callback API instead of our completion queues
+		char* mode_ptr = getenv("GREETER_SERVER_MODE");
+		try {
+			auto server = MakeGreeterServer(ParseGreeterServerMode(mode_ptr == nullptr ? "cq" : mode_ptr));
+			server->Run();
+		} catch (const std::exception& e) {
+			spdlog::error("greeter server: {}", e.what());
+		}
 	}).detach();
 	std::thread([] {
 		std::string target_str = "localhost:50051";
@@ -202,17 +209,13 @@ int main(int argc, char** argv) {
 	std::vector<drogon::HttpClientPtr> http_clients;
 	for (uint32_t i = 0; i < std::thread::hardware_concurrency(); i++)
 		http_clients.emplace_back(drogon::HttpClient::newHttpClient("http://127.0.0.1:9200", event_loop_thread_pool.getNextLoop()));
-	auto get_http_client = [&]() -> auto& {
-		static std::mutex tx;
-		static uint32_t count = 0;
-		std::lock_guard<std::mutex> lk(tx);
-		if (count == std::thread::hardware_concurrency())
-			count = 0;
-		return http_clients[count++];
-	};
+	// least loaded of two random clients instead of blind round-robin
+	LoadBalancer<drogon::HttpClientPtr> balancer{std::move(http_clients)};
 	auto task = [&]() -> drogon::Task<void> {
+		auto lease = balancer.pick();
 		auto http_request_ptr = drogon::HttpRequest::newHttpRequest();
-		auto query_resp = co_await get_http_client()->sendRequestCoro(std::move(http_request_ptr));
+		auto query_resp = co_await lease.backend()->sendRequestCoro(std::move(http_request_ptr));
+		lease.success();
 		spdlog::info("end query!!!");
 		co_return;
 	};
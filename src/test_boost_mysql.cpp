@@ -5,289 +5,69 @@
 #include <utility>
 
 #include <folly/experimental/coro/BlockingWait.h>
+#include <folly/experimental/coro/Collect.h>
 #include <folly/experimental/coro/Task.h>
 #include <spdlog/spdlog.h>
 #include <boost/mysql.hpp>
 
 #include "io_context_pool.h"
+#include "mysql_pipeline.h"
+#include "mysql_pool.h"
+#include "mysql_router.h"
 
-class ConnectAwaiter {
-public:
-	ConnectAwaiter(boost::mysql::tcp_connection& conn, boost::asio::ip::tcp::resolver::results_type& ep, boost::mysql::connection_params& conn_params)
-		: m_conn(conn)
-		, m_ep(ep)
-		, m_conn_params(conn_params) {
-	}
-
-	bool await_ready() const noexcept { return false; }
-	void await_suspend(std::coroutine_handle<> handle) {
-		m_conn.async_connect(*m_ep.begin(), m_conn_params, m_additional_info, [this, handle](boost::system::error_code ec) {
-			m_ec = std::move(ec);
-			handle.resume();
-		});
-	}
-	auto await_resume() noexcept { return m_ec; }
-
-private:
-	boost::mysql::tcp_connection& m_conn;
-	boost::asio::ip::tcp::resolver::results_type& m_ep;
-	boost::mysql::connection_params& m_conn_params;
-	boost::system::error_code m_ec{};
-	boost::mysql::error_info m_additional_info;
-};
-
-inline folly::coro::Task<boost::system::error_code> async_connect(boost::mysql::tcp_connection& conn,
-	boost::asio::ip::tcp::resolver::results_type& ep, boost::mysql::connection_params& conn_params) noexcept {
-	co_return co_await ConnectAwaiter{conn, ep, conn_params};
-}
-
-class ResolveAwaiter {
-public:
-	ResolveAwaiter(boost::asio::io_context& io_context, const std::string& host, const std::string& port)
-		: io_context_(io_context)
-		, m_resolver(io_context.get_executor())
-		, m_host(host)
-		, m_port(port) {
-	}
-
-	bool await_ready() const noexcept { return false; }
-	void await_suspend(std::coroutine_handle<> handle) {
-		m_resolver.async_resolve(m_host.c_str(), m_port.c_str(),
-			[this, handle](boost::system::error_code ec, boost::asio::ip::tcp::resolver::results_type results) {
-				m_ec = std::move(ec);
-				m_results_type = std::move(results);
-				handle.resume();
-			});
-	}
-	auto await_resume() noexcept {
-		return std::make_pair(std::move(m_ec), std::move(m_results_type));
-	}
-
-private:
-	boost::asio::io_context& io_context_;
-	boost::asio::ip::tcp::resolver m_resolver;
-	std::string m_host;
-	std::string m_port;
-	boost::system::error_code m_ec{};
-	boost::asio::ip::tcp::resolver::results_type m_results_type;
-};
-
-inline folly::coro::Task<std::pair<boost::system::error_code, boost::asio::ip::tcp::resolver::results_type>> async_resolve(boost::asio::io_context& io_context,
-	const std::string& host, const std::string& port) noexcept {
-	co_return co_await ResolveAwaiter{io_context, host, port};
-}
-
-class QueryAwaiter {
-public:
-	QueryAwaiter(boost::mysql::tcp_connection& tcp_connection, const std::string& sql)
-		: m_tcp_connection(tcp_connection)
-		, m_sql(sql) {
-	}
-
-	bool await_ready() const noexcept { return false; }
-	void await_suspend(std::coroutine_handle<> handle) {
-		m_tcp_connection.async_query(m_sql.c_str(), m_additional_info, [this, handle](boost::system::error_code ec, auto&& result) {
-			m_ec = std::move(ec);
-			m_resultset = std::move(result);
-			handle.resume();
-		});
-	}
-	auto await_resume() noexcept {
-		return std::make_tuple(std::move(m_ec), std::move(m_additional_info), std::move(m_resultset));
-	}
-
-private:
-	boost::mysql::tcp_connection& m_tcp_connection;
-	std::string m_sql;
-	boost::system::error_code m_ec{};
-	boost::mysql::error_info m_additional_info;
-	boost::mysql::resultset<boost::asio::ip::tcp::socket> m_resultset;
-};
-
-inline folly::coro::Task<std::tuple<boost::system::error_code, boost::mysql::error_info, boost::mysql::resultset<boost::asio::ip::tcp::socket>>> async_query(
-	boost::mysql::tcp_connection& tcp_connection, const std::string& sql) noexcept {
-	co_return co_await QueryAwaiter{tcp_connection, sql};
-}
-
-class ReadAllAwaiter {
-public:
-	ReadAllAwaiter(boost::mysql::resultset<boost::asio::ip::tcp::socket>& resultset)
-		: m_resultset(resultset) {
-	}
-
-	bool await_ready() const noexcept { return false; }
-	void await_suspend(std::coroutine_handle<> handle) {
-		m_resultset.async_read_all(m_additional_info, [this, handle](boost::system::error_code ec, std::vector<boost::mysql::row>&& rows) {
-			m_rows = std::move(rows);
-			m_ec = std::move(ec);
-			handle.resume();
-		});
-	}
-	auto await_resume() noexcept {
-		return std::make_tuple(std::move(m_ec), std::move(m_additional_info), std::move(m_rows));
-	}
-
-private:
-	boost::mysql::resultset<boost::asio::ip::tcp::socket>& m_resultset;
-	boost::system::error_code m_ec{};
-	boost::mysql::error_info m_additional_info{};
-	std::vector<boost::mysql::row> m_rows;
-};
-
-inline folly::coro::Task<std::tuple<boost::system::error_code, boost::mysql::error_info, std::vector<boost::mysql::row>>> read_all(
-	boost::mysql::resultset<boost::asio::ip::tcp::socket>& resultset) noexcept {
-	co_return co_await ReadAllAwaiter{resultset};
-}
-
-class PrepareStatementAwaiter {
-public:
-	PrepareStatementAwaiter(boost::mysql::tcp_connection& tcp_connection, const std::string& sql)
-		: m_tcp_connection(tcp_connection)
-		, m_sql(sql) {
-	}
-
-	bool await_ready() const noexcept { return false; }
-	void await_suspend(std::coroutine_handle<> handle) {
-		m_tcp_connection.async_prepare_statement(m_sql.c_str(), m_additional_info, [this, handle](boost::system::error_code ec, auto&& result) {
-			m_ec = std::move(ec);
-			m_prepared_statement = std::move(result);
-			handle.resume();
-		});
-	}
-	auto await_resume() noexcept {
-		return std::make_tuple(std::move(m_ec), std::move(m_additional_info), std::move(m_prepared_statement));
-	}
-
-private:
-	boost::mysql::tcp_connection& m_tcp_connection;
-	std::string m_sql;
-	boost::system::error_code m_ec{};
-	boost::mysql::error_info m_additional_info{};
-	boost::mysql::prepared_statement<boost::asio::ip::tcp::socket> m_prepared_statement;
-};
-
-inline folly::coro::Task<std::tuple<boost::system::error_code, boost::mysql::error_info, boost::mysql::prepared_statement<boost::asio::ip::tcp::socket>>> async_prepare_statement(
-	boost::mysql::tcp_connection& tcp_connection, const std::string& sql) noexcept {
-	co_return co_await PrepareStatementAwaiter{tcp_connection, sql};
-}
-
-class AsyncExecuteAwaiter {
-public:
-	AsyncExecuteAwaiter(boost::mysql::prepared_statement<boost::asio::ip::tcp::socket>& stmt, std::vector<boost::mysql::value> params)
-		: m_stmt(stmt)
-		, m_params(std::move(params)) {
-	}
-
-	bool await_ready() const noexcept { return false; }
-	void await_suspend(std::coroutine_handle<> handle) {
-		m_stmt.async_execute(m_params, m_additional_info, [this, handle](boost::system::error_code ec, auto&& result) {
-			m_ec = std::move(ec);
-			m_resultset = std::move(result);
-			handle.resume();
-		});
-	}
-	auto await_resume() noexcept {
-		return std::make_pair(std::move(m_ec), std::move(m_resultset));
-	}
-
-private:
-	boost::mysql::prepared_statement<boost::asio::ip::tcp::socket>& m_stmt;
-	std::vector<boost::mysql::value> m_params;
-
-	boost::system::error_code m_ec{};
-	boost::mysql::error_info m_additional_info{};
-	boost::mysql::resultset<boost::asio::ip::tcp::socket> m_resultset;
-};
-
-inline folly::coro::Task<std::pair<boost::system::error_code, boost::mysql::resultset<boost::asio::ip::tcp::socket>>> async_execute(
-	boost::mysql::prepared_statement<boost::asio::ip::tcp::socket>& stmt, std::vector<boost::mysql::value> params) noexcept {
-	co_return co_await AsyncExecuteAwaiter{stmt, std::move(params)};
-}
-
-class AsyncCloseAwaiter {
-public:
-	AsyncCloseAwaiter(boost::mysql::tcp_connection& tcp_connection)
-		: m_tcp_connection(tcp_connection) {
-	}
-
-	bool await_ready() const noexcept { return false; }
-	void await_suspend(std::coroutine_handle<> handle) {
-		m_tcp_connection.async_close(m_additional_info, [this, handle](boost::system::error_code ec) {
-			m_ec = std::move(ec);
-			handle.resume();
-		});
-	}
-	auto await_resume() noexcept {
-		return std::make_tuple(std::move(m_ec), std::move(m_additional_info));
-	}
-
-private:
-	boost::mysql::tcp_connection& m_tcp_connection;
-	boost::system::error_code m_ec{};
-	boost::mysql::error_info m_additional_info{};
-};
-
-inline folly::coro::Task<std::tuple<boost::system::error_code, boost::mysql::error_info>> async_close(
-	boost::mysql::tcp_connection& tcp_connection) noexcept {
-	co_return co_await AsyncCloseAwaiter{tcp_connection};
-}
-
-int main() {
+// ./test_boost_mysql [replica port]..., replicas of the mariadb on 3309 for the read/write splitting part
+int main(int argc, char** argv) {
 	IoContextPool ctx_pool{8};
 	ctx_pool.start();
+	MysqlPoolConfig config;
+	config.port = "3309";
+	config.user = "mybb";
+	config.password = "changeme";
+	config.database = "mybb";
+	MysqlPool pool(config);
+	auto& ctx = ctx_pool.getIoContext();
+	Executor executor{ctx};
+	std::string create_table_sql{"create table mysql_db_test(pk1 varchar(36) NOT NULL PRIMARY KEY, pk2 varchar(36), column1 varchar(32), column2 varchar(32), column3 varchar(32), column4 varchar(32))"};
+	std::string insert_sql{"insert into mysql_db_test VALUES (?, 'pk2', 'test-column1', 'test-column2', 'test-column3', 'test-column4');"};
+	std::string select_sql{"select * from mysql_db_test where pk1 = ?;"};
 	folly::coro::blockingWait([&]() -> folly::coro::Task<void> {
-		auto& ctx = ctx_pool.getIoContext();
-		boost::mysql::tcp_connection conn{ctx};
-		boost::mysql::connection_params params("mybb", "changeme", "mybb");
-		std::string create_table_sql{"create table mysql_db_test(pk1 varchar(36) NOT NULL PRIMARY KEY, pk2 varchar(36), column1 varchar(32), column2 varchar(32), column3 varchar(32), column4 varchar(32))"};
-		std::string insert_sql{"insert into mysql_db_test VALUES (?, 'pk2', 'test-column1', 'test-column2', 'test-column3', 'test-column4');"};
-		std::string select_sql{"select * from mysql_db_test where pk1 = ?;"};
+		auto [acquire_ec, conn] = co_await pool.acquire(ctx);
+		if (acquire_ec) {
+			spdlog::error("acquire: {}", acquire_ec.message());
+			co_return;
+		}
 		{
-			auto [ec, ep] = co_await async_resolve(ctx, "127.0.0.1", "3309");
+			// both statements go out before either response is read, one round trip
+			std::vector<std::string> statements{"DROP TABLE IF EXISTS mysql_db_test", create_table_sql};
+			auto [ec, results] = co_await async_pipeline(*conn, statements);
 			if (ec) {
-				spdlog::error("async_resolve: {}", ec.message());
+				spdlog::error("async_pipeline: {}", ec.message());
+				conn.discard();
 				co_return;
 			}
-			auto ec_ = co_await async_connect(conn, ep, params);
-			if (ec_) {
-				spdlog::error("async_connect: {}", ec_.message());
-				co_return;
+			for (auto& result : results) {
+				if (!result.ok())
+					spdlog::error("{}-{}", result.error_code, result.error_message);
 			}
 		}
 		{
-			co_await async_query(conn, "DROP TABLE IF EXISTS mysql_db_test");
-			auto [ec, ei, _] = co_await async_query(conn, create_table_sql);
-			if (ec)
-				spdlog::error("{}-{}", ec.message(), ei.message());
-		}
-		{
-			auto [pre_insert_ec, pre_insert_ei, stm] = co_await async_prepare_statement(conn, insert_sql);
-			if (pre_insert_ec) {
-				spdlog::error("async_prepare_statement : {}-{}", pre_insert_ec.message(), pre_insert_ei.message());
-				co_return;
-			}
 			std::vector<boost::mysql::value> value{boost::mysql::value{"10086"}};
-			auto [insert_ec, _] = co_await async_execute(stm, std::move(value));
+			auto [insert_ec, insert_ei, _] = co_await async_execute(conn, insert_sql, std::move(value));
 			if (insert_ec) {
-				spdlog::error("async_execute : {}", insert_ec.message());
+				spdlog::error("async_execute : {}-{}", insert_ec.message(), insert_ei.message());
 				co_return;
 			}
 		}
 		{
-			auto [ec, ei, stm] = co_await async_prepare_statement(conn, select_sql);
-			if (ec) {
-				spdlog::error("async_prepare_statement : {}-{}", ec.message(), ei.message());
-				co_return;
-			}
 			std::vector<boost::mysql::value> value{boost::mysql::value{"10086"}};
-			auto [select_ec, result] = co_await async_execute(stm, std::move(value));
+			auto [select_ec, select_ei, result] = co_await async_execute(conn, select_sql, std::move(value));
 			if (select_ec) {
-				spdlog::error("async_execute : {}", ec.message());
+				spdlog::error("async_execute : {}-{}", select_ec.message(), select_ei.message());
 				co_return;
 			}
 			auto [ec_, ei_, rows] = co_await read_all(result);
 			if (ec_) {
-				spdlog::error("read_all : {}-{}", ec_.message(), ei.message());
+				spdlog::error("read_all : {}-{}", ec_.message(), ei_.message());
 				co_return;
 			}
 			if (!result.complete()) {
@@ -300,7 +80,98 @@ int main() {
 				spdlog::info("{}", ss.str());
 			}
 		}
-	}());
+	}().scheduleOn(&executor));
+
+	// concurrent lookups from every io_context, each one acquires and releases: only the first min_size..max_size
+	// acquires per context pay resolve, connect and handshake, and the first lookup per connection the prepare
+	constexpr int32_t lookups = 1000;
+	constexpr int32_t coroutines_per_context = 8;
+	std::vector<std::unique_ptr<Executor>> executors;
+	std::vector<MysqlSubPool*> sub_pools;
+	std::vector<folly::coro::TaskWithExecutor<void>> tasks;
+	auto start = std::chrono::steady_clock::now();
+	for (int32_t i = 0; i < 8; ++i) {
+		auto& context = ctx_pool.getIoContext();
+		executors.emplace_back(std::make_unique<Executor>(context));
+		sub_pools.emplace_back(&pool.subPool(context));
+		for (int32_t j = 0; j < coroutines_per_context; ++j) {
+			tasks.emplace_back([](MysqlSubPool& sub_pool, const std::string& sql) -> folly::coro::Task<void> {
+				for (int32_t n = 0; n < lookups; ++n) {
+					auto [ec, conn] = co_await sub_pool.acquire();
+					if (ec) {
+						spdlog::error("acquire: {}", ec.message());
+						co_return;
+					}
+					std::vector<boost::mysql::value> value{boost::mysql::value{"10086"}};
+					auto [query_ec, ei, result] = co_await async_execute(conn, sql, std::move(value));
+					if (!query_ec)
+						std::tie(query_ec, ei, std::ignore) = co_await read_all(result);
+					if (query_ec) {
+						spdlog::error("lookup: {}-{}", query_ec.message(), ei.message());
+						conn.discard();
+						co_return;
+					}
+				}
+				co_return;
+			}(*sub_pools.back(), select_sql).scheduleOn(executors.back().get()));
+		}
+	}
+	folly::coro::blockingWait(folly::coro::collectAllRange(std::move(tasks)));
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	uint64_t connects = 0;
+	uint64_t reuses = 0;
+	for (auto* sub_pool : sub_pools) {
+		connects += sub_pool->connectCount();
+		reuses += sub_pool->reuseCount();
+	}
+	spdlog::info("{} pooled lookups in {:.3f}s, {} connects, {} reuses", sub_pools.size() * coroutines_per_context * lookups, elapsed.count(),
+		connects, reuses);
+
+	// read/write splitting: without replica ports every statement lands on the primary
+	MysqlRouterConfig router_config;
+	router_config.primary = config;
+	for (int32_t i = 1; i < argc; ++i) {
+		router_config.replicas.emplace_back(config);
+		router_config.replicas.back().port = argv[i];
+	}
+	router_config.read_your_writes = std::chrono::milliseconds(500);
+	MysqlRouter router(router_config);
+	folly::coro::blockingWait([&]() -> folly::coro::Task<void> {
+		MysqlSession session(router, ctx);
+		std::vector<std::string> statements{"START TRANSACTION", "insert into mysql_db_test VALUES ('10087', 'pk2', 'a', 'b', 'c', 'd')",
+			"select * from mysql_db_test where pk1 = '10087'", "COMMIT", "select * from mysql_db_test where pk1 = '10087'"};
+		for (auto& sql : statements) {
+			// reads the rows and gives the replica and, outside the transaction, the connection back
+			auto [ec, ei, rows] = co_await session.queryAll(sql);
+			if (ec) {
+				spdlog::error("{}: {}-{}", sql, ec.message(), ei.message());
+				co_return;
+			}
+			// the read after COMMIT is inside the read your writes window and stays on the primary as well
+			spdlog::info("{} -> {}", sql, session.onReplica() ? "replica" : "primary");
+		}
+	}().scheduleOn(&executor));
+
+	tasks.clear();
+	for (std::size_t i = 0; i < executors.size(); ++i) {
+		for (int32_t j = 0; j < coroutines_per_context; ++j) {
+			tasks.emplace_back([](MysqlRouter& router, boost::asio::io_context& context, const std::string& sql) -> folly::coro::Task<void> {
+				MysqlSession session(router, context);
+				for (int32_t n = 0; n < lookups; ++n) {
+					std::vector<boost::mysql::value> value{boost::mysql::value{"10086"}};
+					auto [ec, ei, rows] = co_await session.executeAll(sql, std::move(value));
+					if (ec) {
+						spdlog::error("routed lookup: {}-{}", ec.message(), ei.message());
+						co_return;
+					}
+				}
+				co_return;
+			}(router, sub_pools[i]->ioContext(), select_sql).scheduleOn(executors[i].get()));
+		}
+	}
+	folly::coro::blockingWait(folly::coro::collectAllRange(std::move(tasks)));
+	for (std::size_t i = 0; i < router.replicaCount(); ++i)
+		spdlog::info("replica {}: {} reads", router_config.replicas[i].port, router.reads(i));
 	ctx_pool.stop();
 	return 0;
 }
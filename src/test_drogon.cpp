@@ -6,6 +6,8 @@
 #include <drogon/drogon.h>
 #include <drogon/utils/coroutine.h>
 
+#include <load_balancer.h>
+
 #include <spdlog/spdlog.h>
 #include <trantor/net/EventLoopThreadPool.h>
 
@@ -82,14 +84,8 @@ int main(int argc, char** argv) {
 	std::vector<drogon::HttpClientPtr> http_clients;
 	for (uint32_t i = 0; i < std::thread::hardware_concurrency(); i++)
 		http_clients.emplace_back(drogon::HttpClient::newHttpClient("http://127.0.0.1:8848", event_loop_thread_pool.getNextLoop()));
-	auto get_http_client = [&]() -> auto& {
-		static std::mutex tx;
-		static uint32_t count = 0;
-		std::lock_guard<std::mutex> lk(tx);
-		if (count == std::thread::hardware_concurrency())
-			count = 0;
-		return http_clients[count++];
-	};
+	// least loaded of two random clients instead of blind round-robin
+	LoadBalancer<drogon::HttpClientPtr> balancer{std::move(http_clients)};
 	auto ws_ptr = drogon::WebSocketClient::newWebSocketClient("ws://127.0.0.1:8848", event_loop_thread_pool.getNextLoop());
 	auto req = drogon::HttpRequest::newHttpRequest();
 	req->setPath("/chat");
@@ -124,9 +120,11 @@ int main(int argc, char** argv) {
 	std::this_thread::sleep_for(std::chrono::seconds(2));
 	auto task = [&]() -> drogon::Task<void> {
 		spdlog::info("send http request...");
+		auto lease = balancer.pick();
 		auto http_request_ptr = drogon::HttpRequest::newHttpRequest();
 		http_request_ptr->setPath("/SayHello/");
-		auto query_resp = co_await get_http_client()->sendRequestCoro(std::move(http_request_ptr));
+		auto query_resp = co_await lease.backend()->sendRequestCoro(std::move(http_request_ptr));
+		lease.success();
 		spdlog::info("{}", query_resp->body());
 		co_return;
 	};
@@ -1,49 +1,273 @@
+#include <io_context_pool.h>
 #include <asio_util.hpp>
+#include <hdr_histogram.h>
 #include <boost/asio.hpp>
+#include <boost/program_options.hpp>
+
+#include <deque>
+#include <fstream>
+#include <random>
 
 #include <spdlog/spdlog.h>
 
+#include <nlohmann/json.hpp>
+
 #include <folly/experimental/coro/BlockingWait.h>
+#include <folly/experimental/coro/Collect.h>
+
+struct LoadOptions {
+	std::string host;
+	std::string port;
+	int32_t threads;
+	int32_t connections;
+	// requests per second over all connections
+	double rate;
+	// "uniform" spacing or "poisson" arrivals
+	std::string arrival;
+	std::chrono::seconds duration;
+	std::chrono::seconds drain_timeout;
+	// "fixed" payload_size, "uniform" in [payload_min, payload_max], "exponential" with mean payload_size
+	std::string payload_distribution;
+	int32_t payload_size;
+	int32_t payload_min;
+	int32_t payload_max;
+	std::string output;
+};
+
+struct ConnectionStats {
+	// nanoseconds from the intended send time, 1ns .. 1h with 3 significant digits
+	HdrHistogram latency{1, 3600LL * 1000 * 1000 * 1000, 3};
+	int64_t sent{0};
+	int64_t received{0};
+	int64_t bytes{0};
+	int64_t errors{0};
+};
+
+class PayloadSize final {
+public:
+	explicit PayloadSize(const LoadOptions& options)
+		: m_options(options) {
+		if (options.payload_distribution != "fixed" && options.payload_distribution != "uniform" && options.payload_distribution != "exponential")
+			throw std::invalid_argument("unknown payload distribution: " + options.payload_distribution);
+	}
+
+	int32_t operator()(std::mt19937_64& rng) {
+		int32_t size = m_options.payload_size;
+		if (m_options.payload_distribution == "uniform")
+			size = std::uniform_int_distribution<int32_t>{m_options.payload_min, m_options.payload_max}(rng);
+		else if (m_options.payload_distribution == "exponential")
+			size = static_cast<int32_t>(std::exponential_distribution<double>{1.0 / m_options.payload_size}(rng));
+		return std::clamp(size, std::max(m_options.payload_min, 1), m_options.payload_max);
+	}
 
-folly::coro::Task<void> start(boost::asio::io_context& io_context, std::string host, std::string port) {
-	boost::asio::ip::tcp::socket socket(io_context);
-	auto ec = co_await async_connect(io_context, socket, host, port);
-	if (ec) {
-		spdlog::error("Connect error: {}", ec.message());
+private:
+	const LoadOptions& m_options;
+};
+
+// Open loop: requests go out on a precomputed schedule whether or not earlier replies are back, and latency is
+// measured from the scheduled send time, so a stalled server shows up in the percentiles instead of silently
+// lowering the offered load (coordinated omission). Replies are matched to requests by byte count because the
+// echo server returns the stream unchanged and in order.
+class LoadConnection final {
+public:
+	LoadConnection(boost::asio::io_context& io_context, const LoadOptions& options, ConnectionStats& stats, uint64_t seed)
+		: m_io_context(io_context)
+		, m_options(options)
+		, m_stats(stats)
+		, m_socket(io_context)
+		, m_send_timer(io_context)
+		, m_drain_timer(io_context)
+		, m_rng(seed)
+		, m_payload_size(options) {
+	}
+
+	folly::coro::Task<void> run(std::chrono::steady_clock::time_point start, const std::string& payload) {
+		auto ec = co_await async_connect(m_io_context, m_socket, m_options.host, m_options.port);
+		if (ec) {
+			spdlog::error("Connect error: {}", ec.message());
+			m_stats.errors++;
+			co_return;
+		}
+		m_socket.set_option(boost::asio::ip::tcp::no_delay(true));
+		co_await folly::coro::collectAll(send(start, payload), receive());
+		boost::system::error_code ignore_ec;
+		m_socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignore_ec);
+		m_socket.close(ignore_ec);
+	}
+
+private:
+	folly::coro::Task<void> send(std::chrono::steady_clock::time_point start, const std::string& payload) {
+		auto rate = m_options.rate / m_options.connections;
+		std::exponential_distribution<double> poisson{rate};
+		auto end = start + m_options.duration;
+		// spread the first sends so the connections do not fire in lockstep
+		auto next = start + std::chrono::nanoseconds(std::uniform_int_distribution<int64_t>{0, static_cast<int64_t>(1e9 / rate)}(m_rng));
+		while (next < end) {
+			m_send_timer.expires_at(next);
+			co_await timeout(m_send_timer);
+			auto size = m_payload_size(m_rng);
+			m_in_flight.emplace_back(next, size);
+			auto [error, length] = co_await async_write(m_socket, boost::asio::buffer(payload.data(), size));
+			if (error) {
+				spdlog::error("write error: {}", error.message());
+				m_stats.errors++;
+				break;
+			}
+			m_stats.sent++;
+			auto interval = m_options.arrival == "poisson" ? poisson(m_rng) : 1.0 / rate;
+			next += std::chrono::nanoseconds(static_cast<int64_t>(interval * 1e9));
+		}
+		m_send_done = true;
+		if (m_in_flight.empty()) {
+			m_socket.cancel();
+			co_return;
+		}
+		m_drain_timer.expires_after(m_options.drain_timeout);
+		m_drain_timer.async_wait([this](const boost::system::error_code& ec) {
+			if (!ec)
+				m_socket.cancel();
+		});
+		co_return;
+	}
+
+	folly::coro::Task<void> receive() {
+		std::vector<char> read_buf(m_options.payload_max);
+		int64_t pending = 0;
+		for (;;) {
+			auto [error, length] = co_await async_read_some(m_socket, boost::asio::buffer(read_buf));
+			if (error) {
+				if (!m_send_done || error != boost::asio::error::operation_aborted || !m_in_flight.empty()) {
+					spdlog::error("read error: {}", error.message());
+					m_stats.errors++;
+				}
+				break;
+			}
+			auto now = std::chrono::steady_clock::now();
+			m_stats.bytes += length;
+			pending += length;
+			while (!m_in_flight.empty() && pending >= m_in_flight.front().second) {
+				pending -= m_in_flight.front().second;
+				m_stats.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_in_flight.front().first).count());
+				m_stats.received++;
+				m_in_flight.pop_front();
+			}
+			if (m_send_done && m_in_flight.empty()) {
+				m_drain_timer.cancel();
+				break;
+			}
+		}
 		co_return;
 	}
-	spdlog::info("Connect to {}:{} successfully", host, port);
-	constexpr int max_length = 1024;
-	char write_buf[max_length] = {"hello"};
-	char read_buf[max_length]{};
-	constexpr int count = 100;
-	for (int i = 0; i < count; ++i) {
-		co_await async_write(socket, boost::asio::buffer(write_buf, max_length));
-		auto [error, reply_length] = co_await async_read_some(socket, boost::asio::buffer(read_buf, max_length));
-		if (error == boost::asio::error::eof) {
-			spdlog::error("server close");
-			break;
-		}
-		else if (error) {
-			spdlog::error("error: {}", error.message());
-			break;
-		}
-	}
-	spdlog::info("Finished send and recieve");
-	boost::system::error_code ignore_ec;
-	socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignore_ec);
-	io_context.stop();
+
+	boost::asio::io_context& m_io_context;
+	const LoadOptions& m_options;
+	ConnectionStats& m_stats;
+	boost::asio::ip::tcp::socket m_socket;
+	boost::asio::steady_timer m_send_timer;
+	boost::asio::steady_timer m_drain_timer;
+	std::mt19937_64 m_rng;
+	PayloadSize m_payload_size;
+	// intended send time and size of every request without a complete reply
+	std::deque<std::pair<std::chrono::steady_clock::time_point, int32_t>> m_in_flight;
+	bool m_send_done{false};
+};
+
+nlohmann::json report(const LoadOptions& options, std::vector<ConnectionStats>& stats, std::chrono::duration<double> elapsed) {
+	ConnectionStats total;
+	for (auto& s : stats) {
+		total.latency.merge(s.latency);
+		total.sent += s.sent;
+		total.received += s.received;
+		total.bytes += s.bytes;
+		total.errors += s.errors;
+	}
+	auto us = [&](double percentile) { return total.latency.valueAtPercentile(percentile) / 1000.0; };
+	nlohmann::json j;
+	j["connections"] = options.connections;
+	j["threads"] = options.threads;
+	j["target_rate"] = options.rate;
+	j["arrival"] = options.arrival;
+	j["payload_distribution"] = options.payload_distribution;
+	j["duration_s"] = elapsed.count();
+	j["sent"] = total.sent;
+	j["received"] = total.received;
+	j["errors"] = total.errors;
+	j["throughput_rps"] = total.received / elapsed.count();
+	j["throughput_mib_s"] = total.bytes / elapsed.count() / (1024 * 1024);
+	j["latency_us"] = {
+		{"min", total.latency.min() / 1000.0},
+		{"mean", total.latency.mean() / 1000.0},
+		{"p50", us(50)},
+		{"p90", us(90)},
+		{"p99", us(99)},
+		{"p99.9", us(99.9)},
+		{"p99.99", us(99.99)},
+		{"max", total.latency.max() / 1000.0},
+	};
+	return j;
 }
 
+// ./test_tcp_client --connections 64 --rate 100000 --duration 30 --payload-distribution uniform --payload-min 64 --payload-max 4096
 int main(int argc, char** argv) {
 	try {
-		boost::asio::io_context io_context;
-		std::thread thd([&] {
-			boost::asio::io_context::work work(io_context);
-			io_context.run();
-		});
-		folly::coro::blockingWait(start(io_context, "127.0.0.1", "8848"));
-		thd.join();
+		LoadOptions options;
+		int64_t duration = 0;
+		int64_t drain_timeout = 0;
+		boost::program_options::options_description desc("open loop tcp load generator");
+		desc.add_options()("help", "print help")
+			("host", boost::program_options::value(&options.host)->default_value("127.0.0.1"), "server host")
+			("port", boost::program_options::value(&options.port)->default_value("8848"), "server port")
+			("threads", boost::program_options::value(&options.threads)->default_value(4), "io_context threads")
+			("connections", boost::program_options::value(&options.connections)->default_value(16), "connections spread over the threads")
+			("rate", boost::program_options::value(&options.rate)->default_value(10000), "target requests per second, all connections")
+			("arrival", boost::program_options::value(&options.arrival)->default_value("uniform"), "uniform | poisson")
+			("duration", boost::program_options::value(&duration)->default_value(10), "seconds")
+			("drain-timeout", boost::program_options::value(&drain_timeout)->default_value(5), "seconds to wait for outstanding replies")
+			("payload-distribution", boost::program_options::value(&options.payload_distribution)->default_value("fixed"), "fixed | uniform | exponential")
+			("payload-size", boost::program_options::value(&options.payload_size)->default_value(1024), "fixed size or exponential mean")
+			("payload-min", boost::program_options::value(&options.payload_min)->default_value(1), "smallest payload")
+			("payload-max", boost::program_options::value(&options.payload_max)->default_value(65536), "largest payload")
+			("output", boost::program_options::value(&options.output), "write the json report to this file instead of stdout");
+		boost::program_options::variables_map vm;
+		boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), vm);
+		boost::program_options::notify(vm);
+		if (vm.count("help")) {
+			std::cout << desc << std::endl;
+			return 0;
+		}
+		options.duration = std::chrono::seconds(duration);
+		options.drain_timeout = std::chrono::seconds(drain_timeout);
+		if (options.connections <= 0 || options.rate <= 0 || options.payload_min > options.payload_max)
+			throw std::invalid_argument("invalid connections, rate or payload range");
+
+		IoContextPool pool(options.threads);
+		pool.start();
+		std::string payload(options.payload_max, 'x');
+		std::vector<ConnectionStats> stats(options.connections);
+		std::unordered_map<boost::asio::io_context*, Executor> executor_map;
+		std::vector<std::unique_ptr<LoadConnection>> connections;
+		std::vector<folly::coro::TaskWithExecutor<void>> tasks;
+		// give every connection time to connect before the schedule starts
+		auto start = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+		for (int32_t i = 0; i < options.connections; ++i) {
+			auto& context = pool.getIoContext();
+			if (!executor_map.contains(&context))
+				executor_map.emplace(&context, Executor{context});
+			connections.emplace_back(std::make_unique<LoadConnection>(context, options, stats[i], std::random_device{}()));
+			tasks.emplace_back(connections.back()->run(start, payload).scheduleOn(&executor_map.at(&context)));
+		}
+		folly::coro::blockingWait(folly::coro::collectAllRange(std::move(tasks)));
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		pool.stop();
+
+		auto j = report(options, stats, elapsed);
+		if (options.output.empty()) {
+			std::cout << j.dump(4) << std::endl;
+		}
+		else {
+			std::ofstream out(options.output);
+			out << j.dump(4) << std::endl;
+		}
 	} catch (std::exception& e) {
 		spdlog::error("Exception: {}", e.what());
 	}
@@ -1,5 +1,12 @@
 #include <io_context_pool.h>
 #include <asio_util.hpp>
+#include <hot_restart.h>
+#include <server_config.h>
+#include <tls_util.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
 
 #include <spdlog/spdlog.h>
 
@@ -7,67 +14,373 @@
 
 class TcpServer final {
 public:
-	TcpServer(IoContextPool& pool)
-		: m_pool(pool) {
+	TcpServer(IoContextPool& pool, const ServerConfig& config)
+		: m_pool(pool)
+		, m_config(config)
+		, m_socket_profile(config.socket_profiles.at(config.socket_profile))
+		, m_accept_context(pool.getIoContext())
+		, m_accept_executor(m_accept_context) {
+		if (m_config.tls)
+			m_ssl_context = std::make_unique<boost::asio::ssl::context>(make_tls_server_context(m_config.tls.value()));
 	}
 
-	folly::coro::Task<void> session(boost::asio::ip::tcp::socket sock, boost::asio::steady_timer steady_timer) {
-		constexpr int32_t max_length = 1024;
-		spdlog::info("start test timeout");
-		steady_timer.expires_after(std::chrono::seconds(2));
-		auto ec_ = co_await timeout(steady_timer);
-		spdlog::info("end test timeout: {}", ec_.message());
+	// Stream is a plain tcp socket, a boost::asio::ssl::stream or a TlsSocket (kernel TLS)
+	template <typename Stream>
+	folly::coro::Task<void> session(Stream sock, boost::asio::steady_timer steady_timer) {
+		// only plain tcp sessions can move to the next generation, TLS state lives in this process
+		constexpr bool transferable = std::is_same_v<Stream, boost::asio::ip::tcp::socket>;
+		auto& lowest_layer = sock.lowest_layer();
+		uint64_t id = 0;
+		// only touched on this session's io_context, like the cancel that transferConnections() posts there
+		bool reading = false;
+		if constexpr (transferable)
+			id = registerSession(sock, reading);
 		// https://www.boost.org/doc/libs/master/boost/asio/error.hpp
-		// ec == boost::asio::error::operation_aborted ?
-		for (;;) {
-			char data[max_length]{};
-			auto [error, length] = co_await async_read_some(sock, boost::asio::buffer(data, max_length));
+		// any pending operation completes with operation_aborted once the idle timer fires
+		// cancel() cannot recall a wait that already completed, so a handler only acts if its arming is still the
+		// current one; the generation outlives the session, the socket does not
+		auto idle_generation = std::make_shared<uint64_t>(0);
+		auto arm_idle_timer = [&] {
+			steady_timer.expires_after(m_config.idle_timeout);
+			steady_timer.async_wait([&lowest_layer, idle_generation, armed = ++*idle_generation](const boost::system::error_code& ec) {
+				if (!ec && *idle_generation == armed)
+					lowest_layer.cancel();
+			});
+		};
+		auto disarm_idle_timer = [&] {
+			++*idle_generation;
+			steady_timer.cancel();
+		};
+		bool ok = true;
+		if constexpr (!transferable) {
+			arm_idle_timer();
+			auto error = co_await async_handshake(sock, boost::asio::ssl::stream_base::server);
+			disarm_idle_timer();
+			if (error) {
+				spdlog::error("[session] handshake: {}", error.message());
+				ok = false;
+			}
+		}
+		std::vector<char> data(m_config.read_buffer_size);
+		while (ok) {
+			if constexpr (transferable) {
+				// between two requests nothing of the connection is buffered in user space
+				if (m_transfer) {
+					disarm_idle_timer();
+					handOver(id, sock);
+					co_return;
+				}
+			}
+			arm_idle_timer();
+			reading = true;
+			auto [error, length] = co_await async_read_some(sock, boost::asio::buffer(data));
+			reading = false;
+			disarm_idle_timer();
 			if (error) {
+				if (transferable && m_transfer && error == boost::asio::error::operation_aborted)
+					continue;
 				spdlog::error("[session] {}", error.message());
 				break;
 			}
-			co_await async_write(sock, boost::asio::buffer(data, length));
+			// a reply cut short must not reach the next generation on a connection that looks healthy
+			if (auto [write_error, written] = co_await async_write(sock, boost::asio::buffer(data.data(), length)); write_error) {
+				spdlog::error("[session] {}", write_error.message());
+				break;
+			}
 		}
+		disarm_idle_timer();
 		boost::system::error_code ec;
-		sock.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
-		sock.close(ec);
+		lowest_layer.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+		lowest_layer.close(ec);
+		if constexpr (transferable)
+			unregisterSession(id);
+		m_live_sessions--;
 		co_return;
 	}
 
 	folly::coro::Task<void> start() {
-		boost::asio::ip::tcp::acceptor acceptor(m_pool.getIoContext());
-		boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), 8848));
-		acceptor.open(endpoint.protocol());
-		acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
-		acceptor.bind(endpoint);
-		acceptor.listen();
+		m_acceptor = std::make_unique<boost::asio::ip::tcp::acceptor>(m_accept_context);
+		boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::make_address(m_config.host), m_config.port);
+		int control = -1;
+		if (m_config.hot_restart) {
+			if (auto inherited = take_over(m_config.hot_restart.value().socket_path)) {
+				m_acceptor->assign(endpoint.protocol(), inherited.value().first);
+				control = inherited.value().second;
+				spdlog::info("hot restart: took over the listening socket");
+			}
+		}
+		if (!m_acceptor->is_open()) {
+			m_acceptor->open(endpoint.protocol());
+			m_acceptor->set_option(boost::asio::ip::tcp::acceptor::reuse_address(m_config.reuse_address));
+			// buffer sizes have to be on the listening socket for the window scale to be negotiated in the SYN-ACK
+			if (m_socket_profile.recv_buffer_size)
+				m_acceptor->set_option(boost::asio::socket_base::receive_buffer_size(m_socket_profile.recv_buffer_size.value()));
+			m_acceptor->bind(endpoint);
+			m_acceptor->listen(m_config.backlog);
+		}
+		if (control >= 0)
+			takeConnections(control, endpoint.protocol()).scheduleOn(&m_accept_executor).start();
+		if (m_config.hot_restart)
+			handoffListener().scheduleOn(&m_accept_executor).start();
+		co_await accept().scheduleOn(&m_accept_executor);
+		co_return;
+	}
+
+	// Called once start() returned after a hand over, waits for the sessions left in this process and for the hand
+	// over to finish: sessions count as gone once they park their fd, the fds and the End message are sent after
+	// that from a pool context, which must still run.
+	void drain() {
+		auto deadline = std::chrono::steady_clock::now() + m_config.hot_restart.value().drain_timeout;
+		while ((!m_handoff_done || m_live_sessions > 0) && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		if (!m_handoff_done)
+			spdlog::error("hot restart: hand over not finished within drain_timeout");
+		spdlog::info("hot restart: drained, {} sessions left", m_live_sessions.load());
+	}
+
+private:
+	folly::coro::Task<void> accept() {
 		for (;;) {
 			auto& context = m_pool.getIoContext();
-			if (!m_executor_map.contains(&context))
-				m_executor_map.emplace(&context, Executor{context});
 			boost::asio::ip::tcp::socket socket(context);
-			auto error = co_await async_accept(acceptor, socket);
+			auto error = co_await async_accept(*m_acceptor, socket);
 			if (error) {
+				if (m_handoff)
+					break;
 				spdlog::error("Accept failed, error: {}", error.message());
 				continue;
 			}
-			boost::asio::steady_timer steady_timer_{context};
-			session(std::move(socket), std::move(steady_timer_)).scheduleOn(&m_executor_map.at(&context)).start();
+			setSocketOption(socket);
+			if (!m_ssl_context)
+				startSession(context, std::move(socket));
+			else if (m_config.tls.value().ktls)
+				startSession(context, TlsSocket{std::move(socket), m_ssl_context->native_handle()});
+			else
+				startSession(context, boost::asio::ssl::stream<boost::asio::ip::tcp::socket>{std::move(socket), *m_ssl_context});
+			if (m_handoff)
+				break;
 		}
 		co_return;
 	}
 
-private:
+	template <typename Stream>
+	void startSession(boost::asio::io_context& context, Stream stream) {
+		if (!m_executor_map.contains(&context))
+			m_executor_map.emplace(&context, Executor{context});
+		m_live_sessions++;
+		boost::asio::steady_timer steady_timer_{context};
+		session(std::move(stream), std::move(steady_timer_)).scheduleOn(&m_executor_map.at(&context)).start();
+	}
+
+	// runs on m_accept_context, next to the accept loop, so the acceptor is never touched from two threads
+	folly::coro::Task<void> handoffListener() {
+		const auto& path = m_config.hot_restart.value().socket_path;
+		::unlink(path.c_str());
+		boost::asio::local::stream_protocol::acceptor control(m_accept_context, boost::asio::local::stream_protocol::endpoint(path));
+		for (;;) {
+			boost::asio::local::stream_protocol::socket peer(m_accept_context);
+			if (auto ec = co_await async_accept(control, peer)) {
+				spdlog::error("hot restart: accept failed, error: {}", ec.message());
+				co_return;
+			}
+			timeval recv_timeout{1, 0};
+			::setsockopt(peer.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &recv_timeout, sizeof(recv_timeout));
+			auto request = recv_fds(peer.native_handle());
+			if (!request || request.value().first != HandoffMessage::Handoff)
+				continue;
+			if (!send_fds(peer.native_handle(), HandoffMessage::Listener, {m_acceptor->native_handle()})) {
+				spdlog::error("hot restart: send listening socket failed: {}", strerror(errno));
+				continue;
+			}
+			spdlog::info("hot restart: listening socket handed over, stop accepting");
+			m_handoff = true;
+			boost::system::error_code ec;
+			m_acceptor->close(ec);
+			if (m_config.hot_restart.value().transfer_connections)
+				co_await transferConnections(peer.native_handle());
+			send_fds(peer.native_handle(), HandoffMessage::End, {});
+			m_handoff_done = true;
+			co_return;
+		}
+	}
+
+	// The previous generation's idle connections, received next to the accept loop while it already serves: they
+	// only come once the old sessions parked them, up to its drain_timeout.
+	folly::coro::Task<void> takeConnections(int control, boost::asio::ip::tcp protocol) {
+		boost::asio::local::stream_protocol::socket peer(m_accept_context, boost::asio::local::stream_protocol(), control);
+		boost::asio::steady_timer deadline(m_accept_context);
+		// as with the idle timer, a completed wait cannot be recalled, the flag outlives the socket
+		auto finished = std::make_shared<bool>(false);
+		deadline.expires_after(m_config.hot_restart.value().drain_timeout + kHandoffTimeout);
+		deadline.async_wait([&peer, finished](const boost::system::error_code& ec) {
+			if (!ec && !*finished)
+				peer.cancel();
+		});
+		size_t taken = 0;
+		for (;;) {
+			if (auto ec = co_await async_wait(peer, boost::asio::socket_base::wait_read)) {
+				spdlog::error("hot restart: waiting for connections: {}", ec.message());
+				break;
+			}
+			auto message = recv_fds(peer.native_handle());
+			if (!message) {
+				spdlog::error("hot restart: previous generation closed before End");
+				break;
+			}
+			auto& [type, fds] = message.value();
+			if (type == HandoffMessage::Connections) {
+				for (auto fd : fds) {
+					auto& context = m_pool.getIoContext();
+					startSession(context, boost::asio::ip::tcp::socket(context, protocol, fd));
+				}
+				taken += fds.size();
+				continue;
+			}
+			for (auto fd : fds)
+				::close(fd);
+			if (type == HandoffMessage::End)
+				break;
+		}
+		*finished = true;
+		deadline.cancel();
+		spdlog::info("hot restart: took over {} connections", taken);
+		co_return;
+	}
+
+	folly::coro::Task<void> transferConnections(int peer) {
+		m_transfer = true;
+		{
+			// wake sessions parked in a read, a session busy with a request hands over when it is done; a write in
+			// progress is never cancelled
+			std::lock_guard<std::mutex> lk(m_session_mutex);
+			for (auto& [id, entry] : m_sessions)
+				boost::asio::post(entry.socket->get_executor(), [this, id = id] {
+					std::lock_guard<std::mutex> lk(m_session_mutex);
+					auto it = m_sessions.find(id);
+					if (it != m_sessions.end() && *it->second.reading)
+						it->second.socket->cancel();
+				});
+		}
+		boost::asio::steady_timer steady_timer(m_accept_context);
+		auto deadline = std::chrono::steady_clock::now() + m_config.hot_restart.value().drain_timeout;
+		while (std::chrono::steady_clock::now() < deadline) {
+			{
+				std::lock_guard<std::mutex> lk(m_session_mutex);
+				if (m_sessions.empty())
+					break;
+			}
+			steady_timer.expires_after(std::chrono::milliseconds(10));
+			co_await timeout(steady_timer);
+		}
+		std::vector<int> fds;
+		{
+			std::lock_guard<std::mutex> lk(m_session_mutex);
+			fds.swap(m_handoff_fds);
+			m_transfer_done = true;
+		}
+		size_t sent = 0;
+		for (size_t i = 0; i < fds.size(); i += kMaxHandoffFds) {
+			std::vector<int> batch(fds.begin() + i, fds.begin() + std::min(fds.size(), i + kMaxHandoffFds));
+			if (send_fds(peer, HandoffMessage::Connections, batch))
+				sent += batch.size();
+		}
+		// the next generation holds its own references now
+		for (auto fd : fds)
+			::close(fd);
+		spdlog::info("hot restart: handed over {} of {} connections", sent, fds.size());
+		co_return;
+	}
+
+	uint64_t registerSession(boost::asio::ip::tcp::socket& socket, bool& reading) {
+		std::lock_guard<std::mutex> lk(m_session_mutex);
+		auto id = m_next_session_id++;
+		m_sessions.emplace(id, SessionEntry{&socket, &reading});
+		return id;
+	}
+
+	void unregisterSession(uint64_t id) {
+		std::lock_guard<std::mutex> lk(m_session_mutex);
+		m_sessions.erase(id);
+	}
+
+	void handOver(uint64_t id, boost::asio::ip::tcp::socket& socket) {
+		boost::system::error_code ec;
+		auto fd = socket.release(ec);
+		{
+			std::lock_guard<std::mutex> lk(m_session_mutex);
+			m_sessions.erase(id);
+			if (!ec && !m_transfer_done)
+				m_handoff_fds.emplace_back(fd);
+			else if (!ec)
+				::close(fd);
+		}
+		m_live_sessions--;
+	}
+
+	void setSocketOption(boost::asio::ip::tcp::socket& socket) {
+		auto set_option = [&socket](const char* name, const auto& option) {
+			boost::system::error_code ec;
+			socket.set_option(option, ec);
+			if (ec)
+				spdlog::error("set socket option {} failed, error: {}", name, ec.message());
+		};
+		set_option("tcp_nodelay", boost::asio::ip::tcp::no_delay(m_socket_profile.tcp_nodelay));
+		set_option("keep_alive", boost::asio::socket_base::keep_alive(m_socket_profile.keep_alive));
+		if (m_socket_profile.recv_buffer_size)
+			set_option("recv_buffer_size", boost::asio::socket_base::receive_buffer_size(m_socket_profile.recv_buffer_size.value()));
+		if (m_socket_profile.send_buffer_size)
+			set_option("send_buffer_size", boost::asio::socket_base::send_buffer_size(m_socket_profile.send_buffer_size.value()));
+	}
+
 	IoContextPool& m_pool;
+	const ServerConfig& m_config;
+	const SocketProfile& m_socket_profile;
+	boost::asio::io_context& m_accept_context;
+	Executor m_accept_executor;
+	std::unique_ptr<boost::asio::ip::tcp::acceptor> m_acceptor;
+	std::unique_ptr<boost::asio::ssl::context> m_ssl_context;
 	std::unordered_map<boost::asio::io_context*, Executor> m_executor_map;
+
+	std::atomic<int64_t> m_live_sessions{0};
+	std::atomic<bool> m_handoff{false};
+	std::atomic<bool> m_transfer{false};
+	// set once the End message went out, drain() keeps the pool running until then
+	std::atomic<bool> m_handoff_done{false};
+	std::mutex m_session_mutex;
+	uint64_t m_next_session_id{0};
+	struct SessionEntry {
+		boost::asio::ip::tcp::socket* socket;
+		// whether the session is parked in a read, only read on the session's io_context
+		bool* reading;
+	};
+	std::unordered_map<uint64_t, SessionEntry> m_sessions;
+	std::vector<int> m_handoff_fds;
+	bool m_transfer_done{false};
 };
 
+// ./test_tcp_server ../src/server_config.yaml
+// with hot_restart configured, starting a second instance takes over from the running one
 int main(int argc, char** argv) {
+	if (argc < 2) {
+		spdlog::error("usage: {} <config.yaml>", argv[0]);
+		return -1;
+	}
+	auto [config, error] = yaml_cpp_struct::from_yaml<ServerConfig>(argv[1]);
+	if (!config) {
+		spdlog::error("{}", error);
+		return -1;
+	}
 	try {
-		IoContextPool pool(10);
-		std::thread thd([&] { pool.start(); });
-		TcpServer server(pool);
+		if (!config.value().socket_profiles.contains(config.value().socket_profile))
+			throw std::runtime_error("unknown socket_profile: " + config.value().socket_profile);
+		IoContextPool pool(config.value().io_context_pool_size);
+		std::thread thd([&] { pool.start(config.value().cpu_affinity.value_or(std::vector<int32_t>{})); });
+		TcpServer server(pool, config.value());
 		folly::coro::blockingWait(server.start());
+		// start() only returns after handing over to the next generation, drain() waits until the hand over is
+		// complete before the pool, which runs it, is stopped
+		if (config.value().hot_restart)
+			server.drain();
 		pool.stop();
 		thd.join();
 	} catch (std::exception& e) {
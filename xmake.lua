@@ -1,10 +1,11 @@
 set_project("xmake-example")
 set_version("0.0.1", {build = "%Y%m%d%H%M"})
-set_xmakever("2.1.0")
+set_xmakever("2.7.1")
 
 add_repositories("repo repo")
 add_requires("folly", "redis-plus-plus 1.3.3", "trantor", "drogon")
 add_requires("fmt 8.1.1", "spdlog v1.9.2", "nlohmann_json v3.10.5")
+add_requires("protobuf-cpp", "grpc")
 
 set_languages("c++20")
 --[[https://xmake.io/mirror/zh-cn/manual/project_target.html]]--
@@ -15,8 +16,18 @@ add_includedirs("include")
 
 target("xmake-example")
     set_kind("binary")
-    add_files("src/*.cpp")
-    add_packages("fmt", "spdlog", "nlohmann_json", "folly", "drogon", "trantor", "redis-plus-plus")
+    add_rules("protobuf.cpp")
+    add_files("src/*.cpp|bench_*.cpp")
+    -- helloworld.pb.* and helloworld.grpc.pb.* are generated at build time, as in CMakeLists.txt
+    add_files("protos/helloworld.proto", {proto_rootdir = "protos", proto_grpc_cpp_plugin = true})
+    add_packages("fmt", "spdlog", "nlohmann_json", "folly", "drogon", "trantor", "redis-plus-plus", "protobuf-cpp", "grpc")
     add_links("uuid")
     add_syslinks("pthread")
+target_end()
+
+target("bench_transport")
+    set_kind("binary")
+    add_files("src/bench_transport.cpp")
+    add_packages("fmt", "spdlog", "folly", "trantor")
+    add_syslinks("pthread")
 target_end()
\ No newline at end of file